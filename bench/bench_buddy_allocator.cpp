@@ -0,0 +1,46 @@
+// Allocation latency of BuddyAllocator across pool sizes.
+//
+// Replays the same randomized allocate/deallocate trace against pools from
+// 16 MB (order 24) up to 4 GB (order 32). With per-order free lists the
+// per-operation cost should stay flat as the pool grows.
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "buddy_allocator.h"
+
+int main() {
+    const size_t operations = 2000000;
+    const size_t maxLive = 256;
+
+    std::cout << "pool_mb   alloc+free_ns" << std::endl;
+    for (size_t order = 24; order <= 32; order += 2) {
+        BuddyAllocator allocator(order);
+        std::mt19937 rng(42);
+        std::uniform_int_distribution<size_t> sizeDist(16, 16 * 1024);
+        std::vector<void*> live;
+        live.reserve(maxLive);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < operations; ++i) {
+            if (live.size() < maxLive && (live.empty() || rng() % 2 == 0)) {
+                void* ptr = allocator.allocate(sizeDist(rng));
+                if (ptr) live.push_back(ptr);
+            } else {
+                size_t victim = rng() % live.size();
+                allocator.deallocate(live[victim]);
+                live[victim] = live.back();
+                live.pop_back();
+            }
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        for (void* ptr : live) allocator.deallocate(ptr);
+
+        double ns = std::chrono::duration<double, std::nano>(end - start).count();
+        std::cout << std::setw(7) << (1ULL << order) / (1024 * 1024) << "   "
+                  << std::fixed << std::setprecision(1) << ns / operations * 2 << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,155 @@
+// Availability-map search cost on a fragmented pool.
+//
+// Replays one randomized alloc/free trace against three first-fit searches
+// over the same 16 MB pool:
+//   vector<bool>  - the original per-block scan with bounds-checked proxies
+//   word+ctz      - 64-bit availability words with a summary word level,
+//                   skipping empty words and finding bits with ctz
+//   BuddyAllocator - the library allocator (free lists + word bitmaps)
+// and reports nanoseconds per operation.
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cstdint>
+#include "buddy_allocator.h"
+
+namespace {
+
+const size_t poolOrder = 24;
+const size_t minOrder = 4;
+
+// Shared buddy bookkeeping; Map decides how availability is stored and searched
+template <typename Map>
+class ScanAllocator {
+public:
+    ScanAllocator() : pool(1ULL << poolOrder), orders((1ULL << poolOrder) >> minOrder, 0) {
+        for (size_t order = 0; order <= poolOrder; ++order) {
+            maps.emplace_back(order < minOrder ? 0 : 1ULL << (poolOrder - order));
+        }
+        maps[poolOrder].set(0, true);
+    }
+
+    void* allocate(size_t size) {
+        size_t needed = minOrder;
+        while ((1ULL << needed) < size) needed++;
+        for (size_t order = needed; order <= poolOrder; ++order) {
+            size_t index;
+            if (!maps[order].findFirst(index)) continue;
+            maps[order].set(index, false);
+            while (order > needed) {
+                order--;
+                index *= 2;
+                maps[order].set(index + 1, true);
+            }
+            orders[(index << needed) >> minOrder] = static_cast<uint8_t>(needed);
+            return pool.data() + (index << needed);
+        }
+        return nullptr;
+    }
+
+    void deallocate(void* ptr) {
+        size_t offset = static_cast<char*>(ptr) - pool.data();
+        size_t order = orders[offset >> minOrder];
+        orders[offset >> minOrder] = 0;
+        size_t index = offset >> order;
+        while (order < poolOrder && maps[order].get(index ^ 1)) {
+            maps[order].set(index ^ 1, false);
+            index /= 2;
+            order++;
+        }
+        maps[order].set(index, true);
+    }
+
+private:
+    std::vector<char> pool;
+    std::vector<uint8_t> orders;
+    std::vector<Map> maps;
+};
+
+// The original layout: one bool proxy per block, scanned linearly
+struct BoolMap {
+    std::vector<bool> bits;
+    explicit BoolMap(size_t count) : bits(count, false) {}
+    bool get(size_t i) const { return i < bits.size() && bits[i]; }
+    void set(size_t i, bool value) { if (i < bits.size()) bits[i] = value; }
+    bool findFirst(size_t& index) const {
+        for (size_t i = 0; i < bits.size(); ++i) {
+            if (get(i)) { index = i; return true; }
+        }
+        return false;
+    }
+};
+
+// 64-bit words plus one summary bit per non-empty word
+struct WordMap {
+    std::vector<uint64_t> words;
+    std::vector<uint64_t> summary;
+    explicit WordMap(size_t count) : words((count + 63) / 64, 0), summary((words.size() + 63) / 64, 0) {}
+    bool get(size_t i) const { return (words[i >> 6] >> (i & 63)) & 1; }
+    void set(size_t i, bool value) {
+        size_t w = i >> 6;
+        if (value) words[w] |= 1ULL << (i & 63);
+        else words[w] &= ~(1ULL << (i & 63));
+        if (words[w]) summary[w >> 6] |= 1ULL << (w & 63);
+        else summary[w >> 6] &= ~(1ULL << (w & 63));
+    }
+    bool findFirst(size_t& index) const {
+        for (size_t s = 0; s < summary.size(); ++s) {
+            if (!summary[s]) continue;
+            size_t w = s * 64 + __builtin_ctzll(summary[s]);
+            index = w * 64 + __builtin_ctzll(words[w]);
+            return true;
+        }
+        return false;
+    }
+};
+
+template <typename Allocator>
+double runTrace(Allocator& allocator, size_t operations) {
+    const size_t maxLive = 2048;
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<size_t> sizeDist(16, 4096);
+    std::vector<void*> live;
+    live.reserve(maxLive);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < operations; ++i) {
+        if (live.size() < maxLive && (live.empty() || rng() % 2 == 0)) {
+            void* ptr = allocator.allocate(sizeDist(rng));
+            if (ptr) live.push_back(ptr);
+        } else {
+            size_t victim = rng() % live.size();
+            allocator.deallocate(live[victim]);
+            live[victim] = live.back();
+            live.pop_back();
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    for (void* ptr : live) allocator.deallocate(ptr);
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / operations;
+}
+
+} // namespace
+
+int main() {
+    const size_t operations = 200000;
+
+    ScanAllocator<BoolMap> boolScan;
+    ScanAllocator<WordMap> wordScan;
+    BuddyAllocator buddy(poolOrder);
+
+    double boolNs = runTrace(boolScan, operations);
+    double wordNs = runTrace(wordScan, operations);
+    double buddyNs = runTrace(buddy, operations);
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "search           ns/op    speedup" << std::endl;
+    std::cout << "vector<bool>  " << std::setw(8) << boolNs << "    1.0x" << std::endl;
+    std::cout << "word+ctz      " << std::setw(8) << wordNs << "    " << boolNs / wordNs << "x" << std::endl;
+    std::cout << "BuddyAllocator" << std::setw(8) << buddyNs << "    " << boolNs / buddyNs << "x" << std::endl;
+    return 0;
+}
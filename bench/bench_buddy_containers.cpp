@@ -0,0 +1,119 @@
+// Standard containers on a buddy pool.
+//
+// Builds the same vector of row offsets and the same node-based map (a
+// histogram of pixel values) with the default allocator, through
+// BuddyMemoryResource as std::pmr containers, and through
+// BuddyStlAllocator<T>, reporting nanoseconds per inserted element. Every
+// variant must produce identical contents, and the pool must be empty once
+// the containers are gone.
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory_resource>
+#include <random>
+#include <vector>
+#include "buddy_allocator.h"
+#include "buddy_memory_resource.h"
+
+namespace {
+
+const size_t vectorElements = 4000000;
+const size_t mapInsertions = 1000000;
+const int repetitions = 5;
+
+double bestNsPerElement(size_t elements, const std::function<void()>& run) {
+    double best = 0;
+    for (int i = 0; i < repetitions; i++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        run();
+        double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        if (i == 0 || seconds < best) best = seconds;
+    }
+    return best * 1e9 / elements;
+}
+
+// Grow a vector one element at a time, as a row table would be built
+template <typename Vector>
+void fillVector(Vector& offsets) {
+    for (size_t i = 0; i < vectorElements; i++) {
+        offsets.push_back(i * 4096);
+    }
+}
+
+// Count pseudo-random pixel values
+template <typename Map>
+void fillMap(Map& histogram) {
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> value(0, 65535);
+    for (size_t i = 0; i < mapInsertions; i++) {
+        histogram[value(rng)]++;
+    }
+}
+
+void printRow(const char* name, double vectorNs, double mapNs) {
+    std::cout << std::left << std::setw(12) << name << std::right << std::fixed << std::setprecision(2)
+              << std::setw(12) << vectorNs << std::setw(12) << mapNs << std::endl;
+}
+
+} // namespace
+
+int main() {
+    using PairAllocator = BuddyStlAllocator<std::pair<const int, size_t>>;
+    using StlVector = std::vector<size_t, BuddyStlAllocator<size_t>>;
+    using StlMap = std::map<int, size_t, std::less<int>, PairAllocator>;
+
+    BuddyAllocator allocator(26);
+    allocator.setPoolLimit(size_t(1) << 30);
+    BuddyMemoryResource resource(&allocator);
+
+    std::vector<size_t> referenceOffsets;
+    std::map<int, size_t> referenceHistogram;
+    fillVector(referenceOffsets);
+    fillMap(referenceHistogram);
+
+    std::cout << "allocator    vector_ns    map_ns" << std::endl;
+    printRow("new/delete",
+             bestNsPerElement(vectorElements, [] { std::vector<size_t> offsets; fillVector(offsets); }),
+             bestNsPerElement(mapInsertions, [] { std::map<int, size_t> histogram; fillMap(histogram); }));
+    printRow("pmr",
+             bestNsPerElement(vectorElements, [&] { std::pmr::vector<size_t> offsets(&resource); fillVector(offsets); }),
+             bestNsPerElement(mapInsertions, [&] { std::pmr::map<int, size_t> histogram(&resource); fillMap(histogram); }));
+    printRow("stl",
+             bestNsPerElement(vectorElements, [&] {
+                 StlVector offsets{BuddyStlAllocator<size_t>(&allocator)};
+                 fillVector(offsets);
+             }),
+             bestNsPerElement(mapInsertions, [&] {
+                 StlMap histogram{PairAllocator(&allocator)};
+                 fillMap(histogram);
+             }));
+
+    // Same contents whichever allocator backs the containers
+    bool identical;
+    {
+        std::pmr::vector<size_t> pmrOffsets(&resource);
+        std::pmr::map<int, size_t> pmrHistogram(&resource);
+        StlVector stlOffsets{BuddyStlAllocator<size_t>(&allocator)};
+        StlMap stlHistogram{PairAllocator(&allocator)};
+        fillVector(pmrOffsets);
+        fillMap(pmrHistogram);
+        fillVector(stlOffsets);
+        fillMap(stlHistogram);
+
+        identical = std::equal(referenceOffsets.begin(), referenceOffsets.end(), pmrOffsets.begin(), pmrOffsets.end()) &&
+                    std::equal(referenceOffsets.begin(), referenceOffsets.end(), stlOffsets.begin(), stlOffsets.end()) &&
+                    std::equal(referenceHistogram.begin(), referenceHistogram.end(),
+                               pmrHistogram.begin(), pmrHistogram.end()) &&
+                    std::equal(referenceHistogram.begin(), referenceHistogram.end(),
+                               stlHistogram.begin(), stlHistogram.end());
+    }
+    size_t leaked = allocator.getTotalAllocated();
+
+    std::cout << "contents " << (identical ? "identical" : "DIFFER") << ", "
+              << leaked << " bytes left in the pool" << std::endl;
+    return identical && leaked == 0 ? 0 : 1;
+}
@@ -0,0 +1,107 @@
+// TLB misses and resident memory of mmap-backed buddy arenas.
+//
+// Rotates a synthetic 24 MP frame out of a buddy pool backed by regular
+// pages, transparent huge pages and explicit huge pages. For each mode it
+// reports the rotation time, dTLB load misses during the bilinear loop (when
+// perf events are available) and RSS before, at the peak of and after the
+// burst, once the freed arenas have been purged.
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "buddy_allocator.h"
+#include "image_processor.h"
+#include "stb_image_write.h"
+
+static double residentMB() {
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * static_cast<double>(sysconf(_SC_PAGESIZE)) / (1024.0 * 1024.0);
+}
+
+static int openTlbCounter() {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+int main() {
+    const int width = 6000, height = 4000, channels = 3;
+    const char* frame = "/tmp/bench_buddy_pages.bmp";
+
+    std::vector<unsigned char> pixels(static_cast<size_t>(width) * height * channels);
+    for (size_t i = 0; i < pixels.size(); ++i) {
+        pixels[i] = static_cast<unsigned char>(i * 31 / 7);
+    }
+    stbi_write_bmp(frame, width, height, channels, pixels.data());
+    std::vector<unsigned char>().swap(pixels);
+
+    const char* names[] = {"normal", "thp", "hugetlb"};
+    const BuddyAllocator::PageMode modes[] = {
+        BuddyAllocator::PageMode::Normal,
+        BuddyAllocator::PageMode::TransparentHuge,
+        BuddyAllocator::PageMode::ExplicitHuge
+    };
+
+    std::cout << "mode      rotate_ms   dtlb_misses   rss_before_mb   rss_peak_mb   rss_after_mb" << std::endl;
+    for (int m = 0; m < 3; ++m) {
+        BuddyAllocator allocator(28, false, modes[m]);
+        allocator.setPoolLimit(1ULL << 30);
+        allocator.setIdleRelease(std::chrono::milliseconds(0));
+        double before = residentMB();
+        double peak = 0.0;
+        double milliseconds = 0.0;
+        long long misses = -1;
+        {
+            ImageProcessor processor(true, &allocator);
+            processor.loadImage(frame);
+
+            int counter = openTlbCounter();
+            if (counter >= 0) {
+                ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+                ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+            }
+            auto start = std::chrono::high_resolution_clock::now();
+            processor.rotateImage(30.0);
+            auto end = std::chrono::high_resolution_clock::now();
+            if (counter >= 0) {
+                ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+                if (read(counter, &misses, sizeof(misses)) != sizeof(misses)) misses = -1;
+                close(counter);
+            }
+
+            milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+            peak = residentMB();
+        }
+        double after = residentMB();
+
+        std::cout << std::left << std::setw(10) << names[m] << std::right << std::fixed
+                  << std::setprecision(1) << std::setw(9) << milliseconds << "   ";
+        if (misses >= 0) {
+            std::cout << std::setw(11) << misses;
+        } else {
+            std::cout << std::setw(11) << "n/a";
+        }
+        std::cout << "   " << std::setw(13) << before << "   " << std::setw(11) << peak
+                  << "   " << std::setw(12) << after << std::endl;
+    }
+
+    std::remove(frame);
+    return 0;
+}
@@ -0,0 +1,61 @@
+// Alloc/free throughput of a shared thread-safe BuddyAllocator.
+//
+// Every thread runs the same randomized trace against one pool, the way
+// worker threads rotating and scaling images would. Per-thread magazines
+// should keep throughput growing with the thread count instead of
+// serializing on the buddy tree lock.
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include "buddy_allocator.h"
+
+static void runTrace(BuddyAllocator& allocator, size_t operations, unsigned seed) {
+    const size_t maxLive = 64;
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<size_t> sizeDist(16, 64 * 1024);
+    std::vector<void*> live;
+    live.reserve(maxLive);
+
+    for (size_t i = 0; i < operations; ++i) {
+        if (live.size() < maxLive && (live.empty() || rng() % 2 == 0)) {
+            void* ptr = allocator.allocate(sizeDist(rng));
+            if (ptr) live.push_back(ptr);
+        } else {
+            size_t victim = rng() % live.size();
+            allocator.deallocate(live[victim]);
+            live[victim] = live.back();
+            live.pop_back();
+        }
+    }
+    for (void* ptr : live) allocator.deallocate(ptr);
+}
+
+int main() {
+    const size_t operationsPerThread = 1000000;
+    const unsigned maxThreads = std::max(8u, std::thread::hardware_concurrency());
+
+    std::cout << "threads   Mops/s   speedup" << std::endl;
+    double baseline = 0.0;
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        BuddyAllocator allocator(28, true);
+        std::vector<std::thread> workers;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (unsigned t = 0; t < threads; ++t) {
+            workers.emplace_back(runTrace, std::ref(allocator), operationsPerThread, 42 + t);
+        }
+        for (auto& worker : workers) worker.join();
+        auto end = std::chrono::high_resolution_clock::now();
+
+        double seconds = std::chrono::duration<double>(end - start).count();
+        double mops = threads * operationsPerThread / seconds / 1e6;
+        if (threads == 1) baseline = mops;
+        std::cout << std::setw(7) << threads << "   " << std::fixed << std::setprecision(2)
+                  << std::setw(6) << mops << "   " << std::setw(6) << mops / baseline << "x" << std::endl;
+    }
+    return 0;
+}
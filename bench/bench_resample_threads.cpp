@@ -0,0 +1,89 @@
+// Rotate and scale throughput vs. thread count.
+//
+// Rotates a synthetic 6000x4000 RGB frame by 30 degrees and scales it by
+// 1.5 with 1, 2, 4, ... threads of a ThreadPool, reporting output megapixels
+// per second and the speedup over one thread. Every run's output is compared
+// with the single-threaded result, which it must match byte for byte.
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <random>
+#include <thread>
+#include <vector>
+#include "resample.h"
+#include "thread_pool.h"
+
+namespace {
+
+const int frameWidth = 6000;
+const int frameHeight = 4000;
+const int channels = 3;
+const int repetitions = 3;
+
+struct Buffer {
+    std::vector<unsigned char> pixels;
+    ImageView view;
+
+    Buffer(int width, int height) : pixels(static_cast<size_t>(width) * channels * height) {
+        view = {pixels.data(), width, height, channels, static_cast<size_t>(width) * channels};
+    }
+};
+
+double bestSeconds(const std::function<void()>& kernel) {
+    double best = 0;
+    for (int i = 0; i < repetitions; i++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        kernel();
+        auto end = std::chrono::high_resolution_clock::now();
+        double seconds = std::chrono::duration<double>(end - start).count();
+        if (i == 0 || seconds < best) best = seconds;
+    }
+    return best;
+}
+
+} // namespace
+
+int main() {
+    const int maxThreads = static_cast<int>(std::max(8u, std::thread::hardware_concurrency()));
+
+    Buffer source(frameWidth, frameHeight);
+    std::mt19937 rng(19);
+    for (unsigned char& value : source.pixels) value = static_cast<unsigned char>(rng());
+
+    const double angle = 30.0;
+    double radians = angle * 3.14159265358979323846 / 180.0;
+    int rotatedWidth = static_cast<int>(frameWidth * std::cos(radians) + frameHeight * std::sin(radians));
+    int rotatedHeight = static_cast<int>(frameWidth * std::sin(radians) + frameHeight * std::cos(radians));
+    Buffer rotated(rotatedWidth, rotatedHeight), rotatedReference(rotatedWidth, rotatedHeight);
+    Buffer scaled(frameWidth * 3 / 2, frameHeight * 3 / 2), scaledReference(frameWidth * 3 / 2, frameHeight * 3 / 2);
+
+    rotateBilinear(source.view, rotatedReference.view, angle);
+    scaleBilinear(source.view, scaledReference.view);
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << frameWidth << "x" << frameHeight << ", " << channels << " channels, "
+              << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+    std::cout << "threads   rotate MP/s   speedup   scale MP/s   speedup   identical" << std::endl;
+    double rotateBase = 0, scaleBase = 0;
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        ThreadPool pool(threads);
+        double rotateMpix = rotatedWidth * static_cast<double>(rotatedHeight) / 1e6 /
+                            bestSeconds([&] { rotateBilinear(source.view, rotated.view, angle, Interpolation::FixedPoint, &pool); });
+        double scaleMpix = scaled.view.width * static_cast<double>(scaled.view.height) / 1e6 /
+                           bestSeconds([&] { scaleBilinear(source.view, scaled.view, Interpolation::FixedPoint, &pool); });
+        if (threads == 1) {
+            rotateBase = rotateMpix;
+            scaleBase = scaleMpix;
+        }
+        bool identical = rotated.pixels == rotatedReference.pixels && scaled.pixels == scaledReference.pixels;
+
+        std::cout << std::setw(7) << threads << std::setw(14) << rotateMpix << std::setw(9) << rotateMpix / rotateBase << "x"
+                  << std::setw(13) << scaleMpix << std::setw(9) << scaleMpix / scaleBase << "x"
+                  << std::setw(12) << (identical ? "yes" : "NO") << std::endl;
+    }
+    return 0;
+}
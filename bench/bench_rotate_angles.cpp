@@ -0,0 +1,83 @@
+// Rotation throughput across angles: row order vs. tiled traversal.
+//
+// Rotates a synthetic 48-megapixel (8000x6000) RGB frame, larger than the
+// last-level cache, by 0 to 90 degrees in 10-degree steps with the default
+// fixed-point kernel, once walking the destination row by row and once tile
+// by tile, and reports output megapixels per second. Row order slows down
+// as the angle grows because each destination row then crosses thousands of
+// source rows; tiles keep the source they read cached.
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <random>
+#include <vector>
+#include "resample.h"
+
+namespace {
+
+const int frameWidth = 8000;
+const int frameHeight = 6000;
+const int channels = 3;
+const int repetitions = 2;
+
+double bestMpix(const std::function<void()>& kernel, double outputPixels) {
+    double best = 0;
+    for (int i = 0; i < repetitions; i++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        kernel();
+        auto end = std::chrono::high_resolution_clock::now();
+        double mpix = outputPixels / 1e6 / std::chrono::duration<double>(end - start).count();
+        if (mpix > best) best = mpix;
+    }
+    return best;
+}
+
+} // namespace
+
+int main() {
+    size_t sourceStride = static_cast<size_t>(frameWidth) * channels;
+    std::vector<unsigned char> source(sourceStride * frameHeight);
+    std::mt19937 rng(13);
+    for (unsigned char& value : source) value = static_cast<unsigned char>(rng());
+    ImageView src = {source.data(), frameWidth, frameHeight, channels, sourceStride};
+
+    // Sized for the largest (45-degree) output and reused for every angle
+    std::vector<unsigned char> target;
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << frameWidth << "x" << frameHeight << ", " << channels << " channels" << std::endl;
+    std::cout << "angle   rows MP/s   tiled MP/s   speedup" << std::endl;
+    double slowestRows = 0, fastestRows = 0, slowestTiled = 0, fastestTiled = 0;
+    for (int angle = 0; angle <= 90; angle += 10) {
+        double radians = angle * 3.14159265358979323846 / 180.0;
+        int dstWidth = static_cast<int>(frameWidth * std::abs(std::cos(radians)) + frameHeight * std::abs(std::sin(radians)));
+        int dstHeight = static_cast<int>(frameWidth * std::abs(std::sin(radians)) + frameHeight * std::abs(std::cos(radians)));
+        size_t dstStride = static_cast<size_t>(dstWidth) * channels;
+        target.resize(dstStride * dstHeight);
+        ImageView dst = {target.data(), dstWidth, dstHeight, channels, dstStride};
+        double outputPixels = static_cast<double>(dstWidth) * dstHeight;
+
+        setTilingEnabled(false);
+        double rows = bestMpix([&] { rotateBilinear(src, dst, angle); }, outputPixels);
+        setTilingEnabled(true);
+        double tiled = bestMpix([&] { rotateBilinear(src, dst, angle); }, outputPixels);
+
+        if (angle == 0) {
+            slowestRows = fastestRows = rows;
+            slowestTiled = fastestTiled = tiled;
+        }
+        slowestRows = std::min(slowestRows, rows);
+        fastestRows = std::max(fastestRows, rows);
+        slowestTiled = std::min(slowestTiled, tiled);
+        fastestTiled = std::max(fastestTiled, tiled);
+
+        std::cout << std::setw(5) << angle << std::setw(12) << rows << std::setw(13) << tiled
+                  << std::setw(9) << tiled / rows << "x" << std::endl;
+    }
+    std::cout << "slowest / fastest angle: rows " << slowestRows / fastestRows
+              << ", tiled " << slowestTiled / fastestTiled << std::endl;
+    return 0;
+}
@@ -0,0 +1,108 @@
+// Three-shear rotation vs. the bilinear kernel: speed and accuracy.
+//
+// Renders a smooth synthetic 4000x3000 RGB pattern, rotates it with
+// rotateBilinear and rotateShear at several angles and reports output
+// megapixels per second for each. Accuracy is the PSNR against the pattern
+// evaluated exactly at every destination pixel's source position, over the
+// pixels at least two pixels inside the rotated frame (edges are handled
+// differently by design), plus the PSNR between the two methods.
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <vector>
+#include "resample.h"
+
+namespace {
+
+const int frameWidth = 4000;
+const int frameHeight = 3000;
+const int channels = 3;
+const int repetitions = 3;
+const double PI = 3.14159265358979323846;
+
+// Band-limited test pattern: a few diagonal waves per channel
+double pattern(double x, double y, int channel) {
+    return 127.5 + 60 * std::sin(0.031 * x + 0.017 * y + channel) + 55 * std::cos(0.023 * y - 0.011 * x + 2 * channel);
+}
+
+double bestMpix(const std::function<void()>& kernel, double outputPixels) {
+    double best = 0;
+    for (int i = 0; i < repetitions; i++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        kernel();
+        auto end = std::chrono::high_resolution_clock::now();
+        double mpix = outputPixels / 1e6 / std::chrono::duration<double>(end - start).count();
+        if (mpix > best) best = mpix;
+    }
+    return best;
+}
+
+double psnr(double squaredError, size_t samples) {
+    if (samples == 0) return 0;
+    double mse = squaredError / samples;
+    return mse > 0 ? 10 * std::log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+} // namespace
+
+int main() {
+    size_t sourceStride = static_cast<size_t>(frameWidth) * channels;
+    std::vector<unsigned char> source(sourceStride * frameHeight);
+    for (int y = 0; y < frameHeight; y++) {
+        for (int x = 0; x < frameWidth; x++) {
+            for (int c = 0; c < channels; c++) {
+                source[y * sourceStride + x * channels + c] = static_cast<unsigned char>(std::lround(pattern(x, y, c)));
+            }
+        }
+    }
+    ImageView src = {source.data(), frameWidth, frameHeight, channels, sourceStride};
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << frameWidth << "x" << frameHeight << ", " << channels << " channels" << std::endl;
+    std::cout << "angle   bilinear MP/s   shear MP/s   speedup   bilinear dB   shear dB   shear vs bilinear dB" << std::endl;
+    for (double angle : {5.0, 15.0, 30.0, 45.0, 60.0, 80.0, 135.0}) {
+        double radians = angle * PI / 180.0;
+        double cosA = std::cos(radians);
+        double sinA = std::sin(radians);
+        int dstWidth = static_cast<int>(frameWidth * std::abs(cosA) + frameHeight * std::abs(sinA));
+        int dstHeight = static_cast<int>(frameWidth * std::abs(sinA) + frameHeight * std::abs(cosA));
+        size_t dstStride = static_cast<size_t>(dstWidth) * channels;
+        std::vector<unsigned char> bilinear(dstStride * dstHeight), shear(dstStride * dstHeight);
+        ImageView bilinearView = {bilinear.data(), dstWidth, dstHeight, channels, dstStride};
+        ImageView shearView = {shear.data(), dstWidth, dstHeight, channels, dstStride};
+        double outputPixels = static_cast<double>(dstWidth) * dstHeight;
+
+        double bilinearMpix = bestMpix([&] { rotateBilinear(src, bilinearView, angle); }, outputPixels);
+        double shearMpix = bestMpix([&] { rotateShear(src, shearView, angle); }, outputPixels);
+
+        // Same inverse mapping as rotateBilinear
+        double bilinearError = 0, shearError = 0, mutualError = 0;
+        size_t samples = 0;
+        for (int y = 0; y < dstHeight; y++) {
+            for (int x = 0; x < dstWidth; x++) {
+                double dx = x - dstWidth / 2.0;
+                double dy = y - dstHeight / 2.0;
+                double sx = frameWidth / 2.0 + cosA * dx + sinA * dy;
+                double sy = frameHeight / 2.0 - sinA * dx + cosA * dy;
+                if (sx < 2 || sy < 2 || sx > frameWidth - 3 || sy > frameHeight - 3) continue;
+                for (int c = 0; c < channels; c++) {
+                    double exact = pattern(sx, sy, c);
+                    double b = bilinear[y * dstStride + x * channels + c];
+                    double s = shear[y * dstStride + x * channels + c];
+                    bilinearError += (b - exact) * (b - exact);
+                    shearError += (s - exact) * (s - exact);
+                    mutualError += (s - b) * (s - b);
+                    samples++;
+                }
+            }
+        }
+
+        std::cout << std::setw(5) << angle << std::setw(16) << bilinearMpix << std::setw(13) << shearMpix
+                  << std::setw(9) << shearMpix / bilinearMpix << "x" << std::setw(14) << psnr(bilinearError, samples)
+                  << std::setw(11) << psnr(shearError, samples) << std::setw(23) << psnr(mutualError, samples) << std::endl;
+    }
+    return 0;
+}
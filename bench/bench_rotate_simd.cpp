@@ -0,0 +1,72 @@
+// Rotation kernel throughput.
+//
+// Rotates a synthetic 4K (3840x2160) frame and a cache-resident 640x480 one
+// by 30 degrees with the double-precision reference kernel, the scalar
+// fixed-point kernel and the AVX2 fixed-point kernel (when the CPU has it)
+// for 1, 3 and 4 channels, and reports output megapixels per second and the
+// speedup over the reference. The 4K source is walked diagonally, so that
+// case is bound by cache and TLB misses rather than arithmetic.
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <random>
+#include <vector>
+#include "resample.h"
+
+namespace {
+
+const double angle = 30.0;
+const int repetitions = 5;
+
+double bestMpix(const std::function<void()>& kernel, double outputPixels) {
+    double best = 0;
+    for (int i = 0; i < repetitions; i++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        kernel();
+        auto end = std::chrono::high_resolution_clock::now();
+        double mpix = outputPixels / 1e6 / std::chrono::duration<double>(end - start).count();
+        if (mpix > best) best = mpix;
+    }
+    return best;
+}
+
+void runFrame(int frameWidth, int frameHeight) {
+    double radians = angle * 3.14159265358979323846 / 180.0;
+    int dstWidth = static_cast<int>(frameWidth * std::abs(std::cos(radians)) + frameHeight * std::abs(std::sin(radians)));
+    int dstHeight = static_cast<int>(frameWidth * std::abs(std::sin(radians)) + frameHeight * std::abs(std::cos(radians)));
+    double outputPixels = static_cast<double>(dstWidth) * dstHeight;
+
+    std::cout << frameWidth << "x" << frameHeight << std::endl;
+    std::cout << "chan   double MP/s   scalar MP/s   simd MP/s   simd speedup" << std::endl;
+    for (int channels : {1, 3, 4}) {
+        std::vector<unsigned char> source(static_cast<size_t>(frameWidth) * frameHeight * channels);
+        std::mt19937 rng(5);
+        for (unsigned char& value : source) value = static_cast<unsigned char>(rng());
+        std::vector<unsigned char> target(static_cast<size_t>(dstWidth) * dstHeight * channels, 0);
+
+        ImageView src = {source.data(), frameWidth, frameHeight, channels, static_cast<size_t>(frameWidth) * channels};
+        ImageView dst = {target.data(), dstWidth, dstHeight, channels, static_cast<size_t>(dstWidth) * channels};
+
+        double reference = bestMpix([&] { rotateBilinear(src, dst, angle, Interpolation::Double); }, outputPixels);
+        setSimdEnabled(false);
+        double scalar = bestMpix([&] { rotateBilinear(src, dst, angle, Interpolation::FixedPoint); }, outputPixels);
+        setSimdEnabled(true);
+        double simd = bestMpix([&] { rotateBilinear(src, dst, angle, Interpolation::FixedPoint); }, outputPixels);
+
+        std::cout << std::setw(4) << channels << std::setw(14) << reference << std::setw(14) << scalar
+                  << std::setw(12) << simd << std::setw(14) << simd / reference << "x" << std::endl;
+    }
+}
+
+} // namespace
+
+int main() {
+    std::cout << std::fixed << std::setprecision(1);
+    runFrame(3840, 2160);
+    std::cout << std::endl;
+    runFrame(640, 480);
+    return 0;
+}
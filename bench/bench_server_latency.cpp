@@ -0,0 +1,205 @@
+// Request latency of the job server under concurrency.
+//
+// Sends thumbnail jobs (a 640x480 JPEG rotated by 10 degrees and scaled by
+// 0.25) to a server from 1, 2, 4 and 8 client threads, each on its own
+// persistent connection, and reports p50/p99 round-trip latency and
+// requests per second. Images travel as bytes both ways, plus one run with
+// file paths instead. Without arguments the server runs in this process
+// with 8 workers and Buddy arenas; pass a socket path to load an external
+// `program_image -serve`. For reference it also times spawning
+// bin/program_image once per job, the cost the server avoids.
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "server.h"
+#include "stb_image_write.h"
+
+extern char** environ;
+
+namespace {
+
+const int frameWidth = 640;
+const int frameHeight = 480;
+const int channels = 3;
+const int requestsPerRun = 400;
+const int spawnRuns = 40;
+const char* inputPath = "/tmp/bench_server_latency.jpg";
+const char* outputPath = "/tmp/bench_server_latency_out.jpg";
+
+double percentile(std::vector<double> samples, double fraction) {
+    std::sort(samples.begin(), samples.end());
+    size_t index = static_cast<size_t>(fraction * (samples.size() - 1) + 0.5);
+    return samples[index];
+}
+
+void printRow(const std::string& mode, int clients, const std::vector<double>& latencies, double seconds) {
+    std::cout << std::left << std::setw(8) << mode << std::right << std::setw(9) << clients
+              << std::setw(10) << latencies.size() << std::fixed << std::setprecision(3)
+              << std::setw(12) << percentile(latencies, 0.50) << std::setw(12) << percentile(latencies, 0.99)
+              << std::setprecision(1) << std::setw(12) << latencies.size() / seconds << std::endl;
+}
+
+// requestsPerRun jobs split over clients threads; false if any job failed
+bool runClients(const std::string& socketPath, int clients, const ServerRequest& request,
+                const std::vector<unsigned char>& input, const std::string& mode) {
+    std::vector<std::vector<double>> latencies(clients);
+    std::atomic<bool> failed(false);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<std::thread> threads;
+    for (int c = 0; c < clients; c++) {
+        threads.emplace_back([&, c] {
+            ServerClient client;
+            if (!client.connect(socketPath)) {
+                failed = true;
+                return;
+            }
+            ServerReply reply;
+            for (int i = c; i < requestsPerRun; i += clients) {
+                auto sent = std::chrono::high_resolution_clock::now();
+                if (!client.process(request, input, reply) || !reply.ok) {
+                    std::cerr << "request failed: " << reply.error << std::endl;
+                    failed = true;
+                    return;
+                }
+                auto received = std::chrono::high_resolution_clock::now();
+                latencies[c].push_back(std::chrono::duration<double, std::milli>(received - sent).count());
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    if (failed) {
+        return false;
+    }
+
+    std::vector<double> all;
+    for (const std::vector<double>& samples : latencies) {
+        all.insert(all.end(), samples.begin(), samples.end());
+    }
+    printRow(mode, clients, all, seconds);
+    return true;
+}
+
+// One program_image process per job, for comparison
+void runSpawned(const std::string& program) {
+    if (access(program.c_str(), X_OK) != 0) {
+        std::cout << "(" << program << " not found, spawn baseline skipped)" << std::endl;
+        return;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+
+    std::vector<std::string> arguments = {program, inputPath, outputPath, "-angulo", "10", "-escalar", "0.25", "-buddy"};
+    std::vector<char*> argv;
+    for (std::string& argument : arguments) {
+        argv.push_back(&argument[0]);
+    }
+    argv.push_back(nullptr);
+
+    std::vector<double> latencies;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < spawnRuns; i++) {
+        auto sent = std::chrono::high_resolution_clock::now();
+        pid_t pid;
+        int status = 0;
+        if (posix_spawn(&pid, program.c_str(), &actions, nullptr, argv.data(), environ) != 0 ||
+            waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            std::cerr << "spawned program_image failed" << std::endl;
+            break;
+        }
+        latencies.push_back(std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - sent).count());
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    posix_spawn_file_actions_destroy(&actions);
+    if (!latencies.empty()) {
+        printRow("spawn", 1, latencies, seconds);
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::vector<unsigned char> pixels(static_cast<size_t>(frameWidth) * frameHeight * channels);
+    for (int y = 0; y < frameHeight; y++) {
+        for (int x = 0; x < frameWidth; x++) {
+            unsigned char* pixel = &pixels[(static_cast<size_t>(y) * frameWidth + x) * channels];
+            pixel[0] = static_cast<unsigned char>(x * 255 / frameWidth);
+            pixel[1] = static_cast<unsigned char>(y * 255 / frameHeight);
+            pixel[2] = static_cast<unsigned char>((x ^ y) & 0xff);
+        }
+    }
+    std::vector<unsigned char> jpeg;
+    stbi_write_jpg_to_func([](void* context, void* data, int size) {
+        std::vector<unsigned char>& output = *static_cast<std::vector<unsigned char>*>(context);
+        output.insert(output.end(), static_cast<unsigned char*>(data), static_cast<unsigned char*>(data) + size);
+    }, &jpeg, frameWidth, frameHeight, channels, pixels.data(), 90);
+    stbi_write_jpg(inputPath, frameWidth, frameHeight, channels, pixels.data(), 90);
+
+    std::atomic<bool> stop(false);
+    std::thread server;
+    std::string socketPath;
+    if (argc > 1) {
+        socketPath = argv[1];
+    } else {
+        socketPath = "/tmp/bench_server_latency.sock";
+        BatchSettings settings;
+        settings.workers = 8;
+        settings.useBuddySystem = true;
+        std::remove(socketPath.c_str());
+        server = std::thread([&] { runServer(socketPath, settings, stop); });
+
+        // Wait for the socket to accept connections
+        ServerClient probe;
+        for (int attempt = 0; attempt < 100 && access(socketPath.c_str(), F_OK) != 0; attempt++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if (!probe.connect(socketPath)) {
+            stop = true;
+            server.join();
+            return 1;
+        }
+    }
+
+    std::cout << "Thumbnail jobs: " << frameWidth << "x" << frameHeight << " JPEG (" << jpeg.size()
+              << " bytes), rotate 10, scale 0.25, " << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+    std::cout << "mode      clients  requests     p50_ms      p99_ms       req/s" << std::endl;
+
+    ServerRequest bytesRequest = {10, 0.25, "-", "-", "jpg"};
+    ServerRequest pathRequest = {10, 0.25, inputPath, outputPath, "-"};
+    bool ok = true;
+    for (int clients = 1; clients <= 8 && ok; clients *= 2) {
+        ok = runClients(socketPath, clients, bytesRequest, jpeg, "bytes");
+    }
+    if (ok) {
+        ok = runClients(socketPath, 1, pathRequest, jpeg, "paths");
+    }
+
+    std::string program = argv[0];
+    size_t slash = program.find_last_of('/');
+    runSpawned((slash == std::string::npos ? std::string(".") : program.substr(0, slash)) + "/program_image");
+
+    if (server.joinable()) {
+        stop = true;
+        server.join();
+    }
+    std::remove(inputPath);
+    std::remove(outputPath);
+    return ok ? 0 : 1;
+}
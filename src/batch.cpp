@@ -0,0 +1,248 @@
+#include "batch.h"
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include "image_processor.h"
+#include "spsc_queue.h"
+#include "thread_pool.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+bool isImageFile(const fs::path& path) {
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+    return ext == ".jpg" || ext == ".jpeg" || ext == ".png" || ext == ".bmp";
+}
+
+double millisecondsSince(std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+} // namespace
+
+bool transformJob(ImageProcessor& processor, double angle, double scale, bool twoPass) {
+    if (!twoPass) {
+        return processor.rotateAndScale(angle, scale);
+    }
+    return processor.rotateImage(angle) && processor.scaleImage(scale);
+}
+
+std::unique_ptr<BuddyAllocator> makeWorkerAllocator(const BatchSettings& settings, bool threadSafe) {
+    if (!settings.useBuddySystem) {
+        return nullptr;
+    }
+    std::unique_ptr<BuddyAllocator> allocator(new BuddyAllocator(settings.poolOrder, threadSafe, settings.pageMode));
+    allocator->setPoolLimit(std::max(settings.poolLimitBytes, size_t(1) << settings.poolOrder));
+    allocator->setIdleRelease(std::chrono::milliseconds(settings.poolIdleMs));
+    return allocator;
+}
+
+bool readManifest(const std::string& path, std::vector<BatchJob>& jobs) {
+    std::ifstream manifest(path);
+    if (!manifest) {
+        std::cerr << "Failed to open manifest: " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    for (int lineNumber = 1; std::getline(manifest, line); lineNumber++) {
+        std::istringstream fields(line);
+        std::string first;
+        if (!(fields >> first) || first[0] == '#') continue;
+
+        BatchJob job;
+        job.inputFile = first;
+        std::string extra;
+        if (!(fields >> job.outputFile >> job.angle >> job.scale) || (fields >> extra)) {
+            std::cerr << path << ":" << lineNumber << ": expected 'input output angle scale'" << std::endl;
+            return false;
+        }
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+bool listDirectory(const std::string& directory, const std::string& outputDirectory,
+                   double angle, double scale, std::vector<BatchJob>& jobs) {
+    std::error_code error;
+    std::vector<fs::path> inputs;
+    for (const fs::directory_entry& entry : fs::directory_iterator(directory, error)) {
+        if (entry.is_regular_file() && isImageFile(entry.path())) {
+            inputs.push_back(entry.path());
+        }
+    }
+    if (error) {
+        std::cerr << "Failed to read directory " << directory << ": " << error.message() << std::endl;
+        return false;
+    }
+
+    fs::create_directories(outputDirectory, error);
+    if (error) {
+        std::cerr << "Failed to create directory " << outputDirectory << ": " << error.message() << std::endl;
+        return false;
+    }
+
+    std::sort(inputs.begin(), inputs.end());
+    for (const fs::path& input : inputs) {
+        jobs.push_back({input.string(), (fs::path(outputDirectory) / input.filename()).string(), angle, scale});
+    }
+    return true;
+}
+
+std::vector<BatchResult> runBatch(const std::vector<BatchJob>& jobs, const BatchSettings& settings,
+                                  const std::function<void(size_t, const BatchResult&)>& report) {
+    std::vector<BatchResult> results(jobs.size());
+    std::atomic<size_t> nextJob(0);
+    std::mutex reportMutex;
+
+    // Images are processed whole on one worker each; a worker's allocator is
+    // only touched by that worker, so it needs no locking
+    int workers = std::max(1, std::min<int>(settings.workers, static_cast<int>(jobs.size())));
+    ThreadPool pool(workers);
+    pool.parallelFor(workers, [&](int) {
+        std::unique_ptr<BuddyAllocator> allocator = makeWorkerAllocator(settings, false);
+        ThreadPool transformPool(settings.transformThreads);
+        ImageProcessor processor(settings.useBuddySystem, allocator.get());
+        processor.setThreadPool(&transformPool);
+        if (settings.shear) {
+            processor.setRotationMode(ImageProcessor::RotationMode::Shear);
+        }
+
+        for (size_t index = nextJob.fetch_add(1); index < jobs.size(); index = nextJob.fetch_add(1)) {
+            const BatchJob& job = jobs[index];
+            BatchResult& result = results[index];
+            result = {false, 0, 0, 0, 0, 0};
+            int channels;
+
+            auto start = std::chrono::high_resolution_clock::now();
+            if (processor.loadImage(job.inputFile)) {
+                processor.getImageInfo(result.inputWidth, result.inputHeight, channels);
+                result.ok = transformJob(processor, job.angle, job.scale, settings.twoPass) &&
+                            processor.saveImage(job.outputFile);
+                processor.getImageInfo(result.outputWidth, result.outputHeight, channels);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            result.milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+
+            std::lock_guard<std::mutex> guard(reportMutex);
+            report(index, result);
+        }
+    });
+    return results;
+}
+
+std::vector<BatchResult> runPipeline(const std::vector<BatchJob>& jobs, const BatchSettings& settings,
+                                     const std::function<void(size_t, const BatchResult&)>& report,
+                                     std::vector<StageUsage>& usage) {
+    using Clock = std::chrono::high_resolution_clock;
+
+    // An image in flight: the processor holding it and the job it belongs to
+    struct Slot {
+        std::unique_ptr<ImageProcessor> processor;
+        size_t job;
+    };
+
+    std::vector<BatchResult> results(jobs.size());
+    int depth = std::max(1, settings.pipelineDepth);
+
+    // Images cross threads between stages, so a shared pool must be thread-safe
+    std::unique_ptr<BuddyAllocator> allocator = makeWorkerAllocator(settings, true);
+    ThreadPool transformPool(settings.transformThreads);
+
+    std::vector<Slot> slots(depth);
+    for (Slot& slot : slots) {
+        slot.processor.reset(new ImageProcessor(settings.useBuddySystem, allocator.get()));
+        slot.processor->setThreadPool(&transformPool);
+        if (settings.shear) {
+            slot.processor->setRotationMode(ImageProcessor::RotationMode::Shear);
+        }
+    }
+
+    // Slot indices flow decode -> transform -> encode and back to decode;
+    // -1 marks the end of the jobs
+    SpscQueue<int> freeSlots(depth), decoded(depth), transformed(depth);
+    for (int i = 0; i < depth; i++) {
+        freeSlots.push(i);
+    }
+
+    double busy[3] = {0, 0, 0};
+    auto start = Clock::now();
+
+    std::thread decoder([&] {
+        for (size_t index = 0; index < jobs.size(); index++) {
+            int slotIndex = freeSlots.pop();
+            Slot& slot = slots[slotIndex];
+            BatchResult& result = results[index];
+            result = {false, 0, 0, 0, 0, 0};
+            slot.job = index;
+
+            auto stageStart = Clock::now();
+            int channels;
+            result.ok = slot.processor->loadImage(jobs[index].inputFile);
+            if (result.ok) {
+                slot.processor->getImageInfo(result.inputWidth, result.inputHeight, channels);
+            }
+            double elapsed = millisecondsSince(stageStart);
+            result.milliseconds += elapsed;
+            busy[0] += elapsed;
+            decoded.push(slotIndex);
+        }
+        decoded.push(-1);
+    });
+
+    std::thread transformer([&] {
+        for (int slotIndex = decoded.pop(); slotIndex >= 0; slotIndex = decoded.pop()) {
+            Slot& slot = slots[slotIndex];
+            const BatchJob& job = jobs[slot.job];
+            BatchResult& result = results[slot.job];
+            if (result.ok) {
+                auto stageStart = Clock::now();
+                result.ok = transformJob(*slot.processor, job.angle, job.scale, settings.twoPass);
+                double elapsed = millisecondsSince(stageStart);
+                result.milliseconds += elapsed;
+                busy[1] += elapsed;
+            }
+            transformed.push(slotIndex);
+        }
+        transformed.push(-1);
+    });
+
+    // Encode on this thread
+    for (int slotIndex = transformed.pop(); slotIndex >= 0; slotIndex = transformed.pop()) {
+        Slot& slot = slots[slotIndex];
+        BatchResult& result = results[slot.job];
+        if (result.ok) {
+            auto stageStart = Clock::now();
+            int channels;
+            result.ok = slot.processor->saveImage(jobs[slot.job].outputFile);
+            slot.processor->getImageInfo(result.outputWidth, result.outputHeight, channels);
+            double elapsed = millisecondsSince(stageStart);
+            result.milliseconds += elapsed;
+            busy[2] += elapsed;
+        }
+        report(slot.job, result);
+        freeSlots.push(slotIndex);
+    }
+
+    decoder.join();
+    transformer.join();
+    double wall = millisecondsSince(start);
+
+    const char* names[3] = {"decode", "transform", "encode"};
+    usage.clear();
+    for (int stage = 0; stage < 3; stage++) {
+        usage.push_back({names[stage], busy[stage], wall});
+    }
+
+    // Release the images before the pool they came from
+    slots.clear();
+    return results;
+}
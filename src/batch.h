@@ -0,0 +1,104 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "buddy_allocator.h"
+
+class ImageProcessor;
+
+// One image of a batch
+struct BatchJob {
+    std::string inputFile;
+    std::string outputFile;
+    double angle;
+    double scale;
+};
+
+// How a batch is processed
+struct BatchSettings {
+    // Worker threads, each with its own ImageProcessor (and Buddy arena and
+    // pool of transformThreads threads) reused for every image it takes
+    int workers = 1;
+
+    // Per-worker allocator: a BuddyAllocator of 2^poolOrder bytes growing up
+    // to poolLimitBytes, or new/delete
+    bool useBuddySystem = false;
+    size_t poolOrder = 24;
+    size_t poolLimitBytes = size_t(4096) * 1024 * 1024;
+    long poolIdleMs = 1000;
+    BuddyAllocator::PageMode pageMode = BuddyAllocator::PageMode::Normal;
+
+    // Rotate and scale in two resamplings instead of one fused warp
+    bool twoPass = false;
+
+    // Rotate with three shears instead of bilinear sampling
+    bool shear = false;
+
+    // runPipeline: images in flight at once (each holds one ImageProcessor)
+    int pipelineDepth = 4;
+
+    // Threads each transform is split over: per worker in runBatch and
+    // runServer, for the transform stage in runPipeline
+    int transformThreads = 1;
+};
+
+// Outcome of one job
+struct BatchResult {
+    bool ok;
+
+    // Time spent processing the image (not waiting in pipeline queues)
+    double milliseconds;
+    int inputWidth;
+    int inputHeight;
+    int outputWidth;
+    int outputHeight;
+};
+
+// Rotate and scale the processor's image in one fused warp, or in two
+// resamplings when twoPass is set
+bool transformJob(ImageProcessor& processor, double angle, double scale, bool twoPass);
+
+// The Buddy allocator a worker (or, threadSafe, a group of threads) draws
+// from under settings, or nullptr when settings use new/delete
+std::unique_ptr<BuddyAllocator> makeWorkerAllocator(const BatchSettings& settings, bool threadSafe);
+
+// Read a manifest with one job per line: input, output, angle and scale
+// separated by whitespace. Blank lines and lines starting with '#' are
+// skipped. Reports the offending line and returns false on a malformed one.
+bool readManifest(const std::string& path, std::vector<BatchJob>& jobs);
+
+// One job per image (jpg, jpeg, png or bmp) in directory, in name order,
+// written under the same name to outputDirectory (created if missing)
+bool listDirectory(const std::string& directory, const std::string& outputDirectory,
+                   double angle, double scale, std::vector<BatchJob>& jobs);
+
+// Process every job on settings.workers threads, which take the next
+// unclaimed job as they finish one and split its transform over their own
+// pool of settings.transformThreads threads. report(index, result) is called as each
+// job completes, one call at a time. Returns the results in job order.
+std::vector<BatchResult> runBatch(const std::vector<BatchJob>& jobs, const BatchSettings& settings,
+                                  const std::function<void(size_t, const BatchResult&)>& report);
+
+// How long one pipeline stage spent working during a run
+struct StageUsage {
+    std::string name;
+    double busyMilliseconds;
+    double wallMilliseconds;
+};
+
+// Process every job in a three-stage pipeline, each stage on its own thread:
+// decode, transform and encode, connected by bounded lock-free queues, so
+// the decode of image N + 1 and the encode of image N - 1 overlap the
+// transform of image N. At most settings.pipelineDepth images are in flight;
+// with the Buddy System they share one thread-safe pool. report is called
+// from the encode stage as each job completes. usage receives each stage's
+// busy time.
+std::vector<BatchResult> runPipeline(const std::vector<BatchJob>& jobs, const BatchSettings& settings,
+                                     const std::function<void(size_t, const BatchResult&)>& report,
+                                     std::vector<StageUsage>& usage);
+
+#endif // BATCH_H
@@ -3,24 +3,103 @@
 #include <cmath>
 #include <algorithm>
 #include <cassert>
+#include <new>
+#include <sstream>
+#include <sys/mman.h>
+#include <unistd.h>
 
-BuddyAllocator::BuddyAllocator(size_t maxOrder) : maxOrder(maxOrder), totalAllocated(0) {
-    poolSize = 1ULL << maxOrder;
-    memoryPool = new char[poolSize];
-    
-    // Initialize available blocks for each order
-    availableBlocks.resize(maxOrder + 1);
-    for (size_t order = 0; order <= maxOrder; ++order) {
-        size_t numBlocks = 1ULL << (maxOrder - order);
-        availableBlocks[order].resize(numBlocks, false);
-    }
-    
-    // Initially, only the largest block is available
-    availableBlocks[maxOrder][0] = true;
+const size_t BuddyAllocator::minOrder;
+const size_t BuddyAllocator::hugePageSize;
+const size_t BuddyAllocator::maxArenas;
+const size_t BuddyAllocator::magazineSize;
+const size_t BuddyAllocator::batchRefillOrder;
+
+namespace {
+
+// Distinguishes allocators in the per-thread cache lookup even when one is
+// destroyed and another is constructed at the same address
+std::atomic<uint64_t> nextAllocatorId(1);
+
+// Last cache this thread used, so the common lookup needs no locking
+struct ThreadCacheSlot {
+    uint64_t allocatorId;
+    void* cache;
+};
+
+thread_local ThreadCacheSlot currentThreadCache = {0, nullptr};
+
+// Reserve size bytes aligned to alignment. Pages are committed lazily by
+// the kernel on first touch. Returns nullptr on failure.
+char* reserveMemory(size_t size, size_t alignment, BuddyAllocator::PageMode pageMode, size_t& mappedSize) {
+    const int protection = PROT_READ | PROT_WRITE;
+    const int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+
+#ifdef MAP_HUGETLB
+    if (pageMode == BuddyAllocator::PageMode::ExplicitHuge && size % (2 * 1024 * 1024) == 0) {
+        // Without MAP_NORESERVE the mapping fails up front instead of
+        // faulting later when the huge page pool runs dry
+        void* huge = mmap(nullptr, size, protection, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (huge != MAP_FAILED) {
+            mappedSize = size;
+            return static_cast<char*>(huge);
+        }
+        // No reserved huge pages: fall through to transparent ones
+    }
+#endif
+
+    // Over-reserve so the start can be aligned, then trim both ends
+    size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    alignment = std::max(alignment, pageSize);
+    size_t reserved = size + alignment - pageSize;
+    void* raw = mmap(nullptr, reserved, protection, flags, -1, 0);
+    if (raw == MAP_FAILED) {
+        return nullptr;
+    }
+
+    char* start = static_cast<char*>(raw);
+    char* aligned = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(start) + alignment - 1) & ~(alignment - 1));
+    if (aligned > start) {
+        munmap(start, aligned - start);
+    }
+    char* end = start + reserved;
+    if (aligned + size < end) {
+        munmap(aligned + size, end - (aligned + size));
+    }
+
+#ifdef MADV_HUGEPAGE
+    if (pageMode != BuddyAllocator::PageMode::Normal) {
+        madvise(aligned, size, MADV_HUGEPAGE);
+    }
+#endif
+
+    mappedSize = size;
+    return aligned;
+}
+
+} // namespace
+
+BuddyAllocator::BuddyAllocator(size_t maxOrder, bool threadSafe, PageMode pageMode)
+    : initialOrder(std::max(maxOrder, minOrder)), poolLimit(0), idleRelease(1000),
+      pageMode(pageMode), purgeThreshold(SIZE_MAX), poolSize(0), arenaSlotCount(1),
+      emptyArenas(0), totalAllocated(0), peakAllocated(0), splitCount(0), mergeCount(0),
+      usage(), threadSafe(threadSafe), allocatorId(nextAllocatorId++) {
+    for (size_t i = 0; i < maxArenas; ++i) {
+        arenaSlots[i].store(nullptr, std::memory_order_relaxed);
+    }
+
+    Arena* arena = createArena(initialOrder);
+    if (!arena) {
+        throw std::bad_alloc();
+    }
+    arenaSlots[0].store(arena, std::memory_order_release);
 }
 
 BuddyAllocator::~BuddyAllocator() {
-    delete[] memoryPool;
+    for (auto& arena : arenaStorage) {
+        if (!arena->released) {
+            munmap(arena->memoryPool, arena->mappedSize);
+        }
+    }
 }
 
 size_t BuddyAllocator::getSizeForOrder(size_t order) const {
@@ -29,194 +108,676 @@ size_t BuddyAllocator::getSizeForOrder(size_t order) const {
 
 size_t BuddyAllocator::getOrderForSize(size_t size) const {
     // Find smallest power of 2 that fits the requested size
-    size_t order = 0;
-    size_t blockSize = 1;
-    
-    while (blockSize < size && order < maxOrder) {
-        blockSize <<= 1;
+    size_t order = minOrder;
+    while (order < 63 && getSizeForOrder(order) < size) {
         order++;
     }
-    
+
     return order;
 }
 
 void* BuddyAllocator::allocate(size_t size) {
     // Minimum allocation size is 16 bytes
-    size = std::max(size, size_t(16));
-    
+    size_t blockSize = std::max(size, size_t(16));
+
     // Find order needed for this allocation
-    size_t orderNeeded = getOrderForSize(size);
-    
-    // Check if order is within our capacity
-    if (orderNeeded > maxOrder) {
-        return nullptr; // Request too large
-    }
-    
-    // Find a block of appropriate size
-    for (size_t currentOrder = orderNeeded; currentOrder <= maxOrder; ++currentOrder) {
-        // Look for available block at this order
-        for (size_t blockIndex = 0; blockIndex < availableBlocks[currentOrder].size(); ++blockIndex) {
-            if (isBlockAvailable(currentOrder, blockIndex)) {
-                // Found an available block
-                
-                // If it's larger than what we need, split it down
-                size_t order = currentOrder;
-                size_t index = blockIndex;
-                
-                // Mark this block as unavailable
-                markBlockUnavailable(order, index);
-                
-                // Split the block until we reach the desired size
-                while (order > orderNeeded) {
-                    splitBlock(order, index);
-                    order--;
-                    index *= 2; // Left child after splitting
-                    
-                    // Mark the left child as unavailable (we'll use it)
-                    markBlockUnavailable(order, index);
-                    // Right child is already marked as available after splitting
-                }
-                
-                // Get address of the allocated block
-                void* ptr = getBlockAddress(orderNeeded, index);
-                
-                // Record allocation details for later deallocation
-                allocatedBlocks[ptr] = orderNeeded;
-                
-                // Update total allocated memory
-                totalAllocated += getSizeForOrder(orderNeeded);
-                
-                return ptr;
-            }
-        }
+    size_t orderNeeded = getOrderForSize(blockSize);
+    if (getSizeForOrder(orderNeeded) < blockSize) {
+        orderNeeded = 0; // Request too large
+    }
+
+    if (threadSafe) {
+        return allocateCached(orderNeeded, size);
+    }
+
+    void* ptr = orderNeeded ? allocateBlock(orderNeeded) : nullptr;
+    recordAllocation(usage, size, orderNeeded, ptr != nullptr);
+
+    // Arenas emptied by the last free expire here when no free follows
+    releaseIdleArenasLocked();
+    return ptr;
+}
+
+void BuddyAllocator::recordAllocation(UsageCounters& counters, size_t size, size_t order, bool succeeded) {
+    if (!succeeded) {
+        counters.failedAllocations++;
+        return;
+    }
+    counters.allocations++;
+    counters.requestedBytes += size;
+    counters.roundedBytes += getSizeForOrder(order);
+}
+
+void* BuddyAllocator::allocateAligned(size_t size, size_t alignment) {
+    if (alignment == 0 || (alignment & (alignment - 1)) || alignment > hugePageSize) {
+        return nullptr; // Unsupported alignment
     }
-    
-    // No available block found
-    return nullptr;
+
+    // Blocks are aligned to their own size inside arenas aligned to
+    // min(arena size, 2 MB), so a block of at least alignment bytes suffices
+    return allocate(std::max(size, alignment));
 }
 
 void BuddyAllocator::deallocate(void* ptr) {
     if (!ptr) return;
-    
-    // Find the order and index of the block
-    auto it = allocatedBlocks.find(ptr);
-    if (it == allocatedBlocks.end()) {
+
+    // Find the arena, order and index of the block
+    BlockRef block = findBlock(ptr);
+    if (!block.arena) {
         return; // Not allocated by this allocator
     }
-    
-    size_t order = it->second;
-    size_t size = getSizeForOrder(order);
-    
-    // Calculate block index based on pointer address
-    char* charPtr = static_cast<char*>(ptr);
-    size_t offset = charPtr - memoryPool;
-    size_t blockIndex = offset / size;
-    
-    // Mark the block as available
-    markBlockAvailable(order, blockIndex);
-    
-    // Update total allocated memory
-    totalAllocated -= size;
-    
-    // Attempt to merge with buddy blocks
-    while (order < maxOrder) {
-        size_t buddyIndex = blockIndex ^ 1; // XOR with 1 to get buddy index
-        
-        // If buddy is also available, merge them
-        if (isBlockAvailable(order, buddyIndex)) {
-            // Mark both blocks as unavailable at this level
-            markBlockUnavailable(order, blockIndex);
-            markBlockUnavailable(order, buddyIndex);
-            
-            // Move up to the parent block
-            blockIndex /= 2;
-            order++;
-            
-            // Mark parent as available
-            markBlockAvailable(order, blockIndex);
+
+    if (threadSafe) {
+        deallocateCached(ptr, block);
+        return;
+    }
+
+    usage.deallocations++;
+    releaseBlock(block);
+    releaseIdleArenasLocked();
+}
+
+bool BuddyAllocator::owns(const void* ptr) const {
+    return ptr && findBlock(ptr).arena != nullptr;
+}
+
+size_t BuddyAllocator::blockSize(const void* ptr) const {
+    BlockRef block = ptr ? findBlock(ptr) : BlockRef{nullptr, 0, 0};
+    return block.arena ? getSizeForOrder(block.order) : 0;
+}
+
+void* BuddyAllocator::allocateBlock(size_t order, bool mayGrow) {
+    // Older arenas are preferred so that recently grown ones can drain
+    size_t slotCount = arenaSlotCount.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < slotCount; ++i) {
+        Arena* arena = arenaSlots[i].load(std::memory_order_relaxed);
+        if (arena && order <= arena->maxOrder) {
+            void* ptr = allocateFromArena(*arena, order);
+            if (ptr) return ptr;
+        }
+    }
+
+    // Check if the pool may grow to satisfy the request
+    Arena* arena = mayGrow ? growPool(order) : nullptr;
+    if (!arena) {
+        return nullptr;
+    }
+
+    return allocateFromArena(*arena, order);
+}
+
+void* BuddyAllocator::allocateFromArena(Arena& arena, size_t orderNeeded) {
+    // The first non-empty free list at or above the needed order holds our block
+    size_t order = orderNeeded;
+    while (order <= arena.maxOrder && !arena.freeLists[order]) {
+        ++order;
+    }
+
+    if (order > arena.maxOrder) {
+        return nullptr; // No available block found
+    }
+
+    size_t index = popFreeBlock(arena, order);
+
+    // Split the block until we reach the desired size, keeping the left child
+    while (order > orderNeeded) {
+        splitBlock(arena, order, index);
+        order--;
+        index *= 2;
+    }
+
+    // Get address of the allocated block
+    void* ptr = getBlockAddress(arena, orderNeeded, index);
+
+    // Record allocation details for later deallocation
+    arena.blockOrders[(index << orderNeeded) >> minOrder] = static_cast<uint8_t>(orderNeeded);
+
+    // Update allocated memory; an idle arena is back in use
+    if (arena.idle) {
+        arena.idle = false;
+        emptyArenas--;
+    }
+    arena.allocated += getSizeForOrder(orderNeeded);
+    totalAllocated += getSizeForOrder(orderNeeded);
+    peakAllocated = std::max(peakAllocated, totalAllocated);
+
+    return ptr;
+}
+
+void BuddyAllocator::releaseBlock(const BlockRef& block) {
+    Arena& arena = *block.arena;
+    size_t order = block.order;
+    size_t blockIndex = block.blockIndex;
+
+    // Update allocated memory
+    arena.allocated -= getSizeForOrder(order);
+    totalAllocated -= getSizeForOrder(order);
+
+    // Forget the allocation record
+    arena.blockOrders[(blockIndex << order) >> minOrder] = 0;
+
+    // Merge with free buddies as far up as possible
+    while (order < arena.maxOrder && isBlockAvailable(arena, order, getBuddyIndex(blockIndex))) {
+        mergeBlocks(arena, order, blockIndex);
+        blockIndex /= 2;
+        order++;
+    }
+
+    // Large free blocks give their pages back before the list node is written
+    if (getSizeForOrder(order) >= purgeThreshold) {
+        purgeBlock(arena, order, blockIndex);
+    }
+
+    // Mark the (possibly merged) block as available
+    pushFreeBlock(arena, order, blockIndex);
+
+    // Start the idle clock on arenas that just became empty
+    if (arena.allocated == 0) {
+        arena.emptySince = std::chrono::steady_clock::now();
+        arena.idle = true;
+        emptyArenas++;
+    }
+}
+
+BuddyAllocator::Arena* BuddyAllocator::createArena(size_t order) {
+    std::unique_ptr<Arena> arena(new Arena());
+    arena->maxOrder = order;
+    arena->poolSize = getSizeForOrder(order);
+    arena->released = false;
+    arena->allocated = 0;
+    arena->emptySince = std::chrono::steady_clock::now();
+    arena->idle = false;
+    arena->memoryPool = reserveMemory(arena->poolSize, std::min(arena->poolSize, hugePageSize),
+                                      pageMode, arena->mappedSize);
+    if (!arena->memoryPool) {
+        return nullptr;
+    }
+
+    try {
+        // Initialize available blocks and free lists for each order
+        size_t words = 0;
+        arena->availableOffsets.assign(order + 1, 0);
+        arena->freeLists.assign(order + 1, nullptr);
+        for (size_t level = minOrder; level <= order; ++level) {
+            size_t numBlocks = 1ULL << (order - level);
+            arena->availableOffsets[level] = words;
+            words += (numBlocks + 63) / 64;
+        }
+        arena->availableWords.assign(words, 0);
+        arena->blockOrders.assign(arena->poolSize >> minOrder, 0);
+    } catch (const std::bad_alloc&) {
+        munmap(arena->memoryPool, arena->mappedSize);
+        return nullptr;
+    }
+
+    // Initially, only the largest block is available
+    pushFreeBlock(*arena, order, 0);
+
+    poolSize += arena->poolSize;
+    arenaStorage.push_back(std::move(arena));
+    return arenaStorage.back().get();
+}
+
+void BuddyAllocator::destroyArena(Arena& arena) {
+    munmap(arena.memoryPool, arena.mappedSize);
+    arena.released = true;
+    std::vector<uint64_t>().swap(arena.availableWords);
+    std::vector<size_t>().swap(arena.availableOffsets);
+    std::vector<FreeBlock*>().swap(arena.freeLists);
+    std::vector<uint8_t>().swap(arena.blockOrders);
+    poolSize -= arena.poolSize;
+}
+
+BuddyAllocator::Arena* BuddyAllocator::growPool(size_t order) {
+    size_t arenaOrder = std::max(order, initialOrder);
+    size_t arenaSize = getSizeForOrder(arenaOrder);
+    if (arenaSize > poolLimit) {
+        return nullptr; // Request larger than the hard cap
+    }
+
+    // Empty grown arenas could not serve this request; make room for one that can
+    if (poolSize + arenaSize > poolLimit && emptyArenas > 0) {
+        size_t slotCount = arenaSlotCount.load(std::memory_order_relaxed);
+        for (size_t i = 1; i < slotCount; ++i) {
+            Arena* arena = arenaSlots[i].load(std::memory_order_relaxed);
+            if (arena && arena->allocated == 0) {
+                arenaSlots[i].store(nullptr, std::memory_order_release);
+                destroyArena(*arena);
+                if (arena->idle) {
+                    emptyArenas--;
+                }
+            }
+        }
+    }
+
+    if (poolSize + arenaSize > poolLimit) {
+        return nullptr; // Hard cap reached
+    }
+
+    size_t slot = 1;
+    while (slot < maxArenas && arenaSlots[slot].load(std::memory_order_relaxed)) {
+        ++slot;
+    }
+    if (slot == maxArenas) {
+        return nullptr;
+    }
+
+    Arena* arena = createArena(arenaOrder);
+    if (!arena) {
+        return nullptr;
+    }
+
+    // Counted as idle until allocateFromArena hands out its first block
+    arena->idle = true;
+    emptyArenas++;
+    arenaSlots[slot].store(arena, std::memory_order_release);
+    if (slot >= arenaSlotCount.load(std::memory_order_relaxed)) {
+        arenaSlotCount.store(slot + 1, std::memory_order_release);
+    }
+    return arena;
+}
+
+void BuddyAllocator::purgeBlock(Arena& arena, size_t order, size_t blockIndex) {
+    // MADV_DONTNEED drops the pages immediately so RSS falls right away;
+    // they come back zero-filled on the next touch
+    char* block = static_cast<char*>(getBlockAddress(arena, order, blockIndex));
+    size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    if (getSizeForOrder(order) >= pageSize) {
+        madvise(block, getSizeForOrder(order), MADV_DONTNEED);
+    }
+}
+
+void BuddyAllocator::setPurgeThreshold(size_t bytes) {
+    std::lock_guard<std::mutex> guard(poolMutex);
+    purgeThreshold = bytes;
+}
+
+void BuddyAllocator::setPoolLimit(size_t maxBytes) {
+    std::lock_guard<std::mutex> guard(poolMutex);
+    poolLimit = maxBytes;
+}
+
+void BuddyAllocator::setIdleRelease(std::chrono::milliseconds period) {
+    std::lock_guard<std::mutex> guard(poolMutex);
+    idleRelease = period;
+}
+
+void BuddyAllocator::releaseIdleArenas() {
+    std::lock_guard<std::mutex> guard(poolMutex);
+    releaseIdleArenasLocked();
+}
+
+void BuddyAllocator::releaseIdleArenasLocked() {
+    if (emptyArenas == 0) return;
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    size_t slotCount = arenaSlotCount.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < slotCount; ++i) {
+        Arena* arena = arenaSlots[i].load(std::memory_order_relaxed);
+        if (!arena || !arena->idle || now - arena->emptySince < idleRelease) {
+            continue;
+        }
+
+        arena->idle = false;
+        emptyArenas--;
+        if (i == 0) {
+            // The initial arena stays mapped; only its pages go back
+            removeFreeBlock(*arena, arena->maxOrder, 0);
+            purgeBlock(*arena, arena->maxOrder, 0);
+            pushFreeBlock(*arena, arena->maxOrder, 0);
         } else {
-            // Cannot merge further
+            arenaSlots[i].store(nullptr, std::memory_order_release);
+            destroyArena(*arena);
+        }
+    }
+}
+
+BuddyAllocator::ThreadCache* BuddyAllocator::getThreadCache() {
+    if (currentThreadCache.allocatorId == allocatorId) {
+        return static_cast<ThreadCache*>(currentThreadCache.cache);
+    }
+
+    std::thread::id self = std::this_thread::get_id();
+    std::lock_guard<std::mutex> guard(poolMutex);
+
+    ThreadCache* cache = nullptr;
+    for (auto& candidate : threadCaches) {
+        if (candidate->owner == self) {
+            cache = candidate.get();
             break;
         }
     }
-    
-    // Remove from allocated blocks map
-    allocatedBlocks.erase(it);
+
+    if (!cache) {
+        threadCaches.emplace_back(new ThreadCache());
+        cache = threadCaches.back().get();
+        cache->owner = self;
+        cache->usage = UsageCounters();
+        std::fill(cache->counts, cache->counts + 64, 0);
+    }
+
+    currentThreadCache.allocatorId = allocatorId;
+    currentThreadCache.cache = cache;
+    return cache;
+}
+
+void* BuddyAllocator::allocateCached(size_t order, size_t size) {
+    ThreadCache* cache = getThreadCache();
+    if (order == 0) {
+        std::lock_guard<std::mutex> guard(cache->lock);
+        recordAllocation(cache->usage, size, order, false);
+        return nullptr;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(cache->lock);
+        if (cache->counts[order] > 0) {
+            recordAllocation(cache->usage, size, order, true);
+            void* ptr = cache->blocks[order][--cache->counts[order]];
+            blockOrderEntry(findBlock(ptr)) &= ~cachedMark;
+            return ptr;
+        }
+    }
+
+    // Miss: take the block (and, for small orders, a few spares) from the tree
+    size_t spareCount = order < batchRefillOrder ? magazineSize / 2 : 0;
+    void* spares[magazineSize];
+    size_t sparesTaken = 0;
+    void* ptr;
+    {
+        std::lock_guard<std::mutex> guard(poolMutex);
+        ptr = allocateBlock(order);
+        if (!ptr) {
+            // Blocks parked in other threads' caches may be enough to satisfy us
+            flushThreadCachesLocked();
+            ptr = allocateBlock(order);
+        }
+        // Spares only come from arenas that already exist; growing the pool
+        // for blocks nobody asked for yet would defeat the pool limit
+        while (ptr && sparesTaken < spareCount) {
+            void* spare = allocateBlock(order, false);
+            if (!spare) break;
+            blockOrderEntry(findBlock(spare)) |= cachedMark;
+            spares[sparesTaken++] = spare;
+        }
+        releaseIdleArenasLocked();
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(cache->lock);
+        recordAllocation(cache->usage, size, order, ptr != nullptr);
+        for (size_t i = 0; i < sparesTaken; ++i) {
+            cache->blocks[order][cache->counts[order]++] = spares[i];
+        }
+    }
+
+    return ptr;
+}
+
+void BuddyAllocator::deallocateCached(void* ptr, const BlockRef& block) {
+    ThreadCache* cache = getThreadCache();
+    size_t order = block.order;
+    if (order >= batchRefillOrder) {
+        {
+            std::lock_guard<std::mutex> guard(cache->lock);
+            cache->usage.deallocations++;
+        }
+        std::lock_guard<std::mutex> guard(poolMutex);
+        releaseBlock(findBlock(ptr));
+        releaseIdleArenasLocked();
+        return;
+    }
+
+    // Full magazines spill their older half back to the tree
+    void* spill[magazineSize];
+    size_t spillCount = 0;
+    {
+        std::lock_guard<std::mutex> guard(cache->lock);
+
+        // A block already waiting in a cache is being freed twice; caching it
+        // again would hand the same address to two callers
+        uint8_t& entry = blockOrderEntry(block);
+        if (entry & cachedMark) {
+            return;
+        }
+        entry |= cachedMark;
+
+        cache->usage.deallocations++;
+        size_t& count = cache->counts[order];
+        if (count == magazineSize) {
+            spillCount = magazineSize / 2;
+            std::copy(cache->blocks[order], cache->blocks[order] + spillCount, spill);
+            std::copy(cache->blocks[order] + spillCount, cache->blocks[order] + count, cache->blocks[order]);
+            count -= spillCount;
+        }
+        cache->blocks[order][count++] = ptr;
+    }
+
+    if (spillCount > 0) {
+        std::lock_guard<std::mutex> guard(poolMutex);
+        for (size_t i = 0; i < spillCount; ++i) {
+            releaseBlock(findBlock(spill[i]));
+        }
+        releaseIdleArenasLocked();
+    }
+}
+
+void BuddyAllocator::flushThreadCaches() {
+    std::lock_guard<std::mutex> guard(poolMutex);
+    flushThreadCachesLocked();
+    releaseIdleArenasLocked();
+}
+
+void BuddyAllocator::flushThreadCachesLocked() {
+    // Cache locks are only ever taken after poolMutex, never the other way round
+    for (auto& cache : threadCaches) {
+        std::lock_guard<std::mutex> guard(cache->lock);
+        for (size_t order = minOrder; order < 64; ++order) {
+            for (size_t i = 0; i < cache->counts[order]; ++i) {
+                releaseBlock(findBlock(cache->blocks[order][i]));
+            }
+            cache->counts[order] = 0;
+        }
+    }
 }
 
 size_t BuddyAllocator::getTotalAllocated() const {
+    std::lock_guard<std::mutex> guard(poolMutex);
     return totalAllocated;
 }
 
-void BuddyAllocator::markBlockUnavailable(size_t order, size_t blockIndex) {
-    if (order <= maxOrder && blockIndex < availableBlocks[order].size()) {
-        availableBlocks[order][blockIndex] = false;
+size_t BuddyAllocator::getPoolSize() const {
+    std::lock_guard<std::mutex> guard(poolMutex);
+    return poolSize;
+}
+
+// Callers only pass orders in [minOrder, maxOrder] and indices inside the
+// level, so the bitmap is accessed without bounds checks
+
+BuddyAllocator::Stats BuddyAllocator::stats() const {
+    std::lock_guard<std::mutex> guard(poolMutex);
+
+    Stats result = Stats();
+    result.allocatedBytes = totalAllocated;
+    result.peakAllocatedBytes = peakAllocated;
+    result.poolBytes = poolSize;
+    result.splits = splitCount;
+    result.merges = mergeCount;
+    result.freeBlocks.assign(minOrder, 0);
+
+    size_t slotCount = arenaSlotCount.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < slotCount; ++i) {
+        const Arena* arena = arenaSlots[i].load(std::memory_order_relaxed);
+        if (!arena) continue;
+
+        result.arenaCount++;
+        if (result.freeBlocks.size() <= arena->maxOrder) {
+            result.freeBlocks.resize(arena->maxOrder + 1, 0);
+        }
+        for (size_t order = minOrder; order <= arena->maxOrder; ++order) {
+            for (const FreeBlock* block = arena->freeLists[order]; block; block = block->next) {
+                result.freeBlocks[order]++;
+            }
+            if (arena->freeLists[order]) {
+                result.largestFreeBlock = std::max(result.largestFreeBlock, getSizeForOrder(order));
+            }
+        }
+    }
+
+    // Calls in concurrent mode are counted per thread
+    UsageCounters total = usage;
+    for (auto& cache : threadCaches) {
+        std::lock_guard<std::mutex> cacheGuard(cache->lock);
+        total.allocations += cache->usage.allocations;
+        total.deallocations += cache->usage.deallocations;
+        total.failedAllocations += cache->usage.failedAllocations;
+        total.requestedBytes += cache->usage.requestedBytes;
+        total.roundedBytes += cache->usage.roundedBytes;
+        for (size_t order = minOrder; order < 64; ++order) {
+            result.cachedBlocks += cache->counts[order];
+        }
+    }
+    result.allocations = total.allocations;
+    result.deallocations = total.deallocations;
+    result.failedAllocations = total.failedAllocations;
+    result.requestedBytes = total.requestedBytes;
+    result.roundedBytes = total.roundedBytes;
+
+    return result;
+}
+
+double BuddyAllocator::Stats::internalFragmentation() const {
+    if (roundedBytes == 0) return 0.0;
+    return 1.0 - static_cast<double>(requestedBytes) / static_cast<double>(roundedBytes);
+}
+
+std::string BuddyAllocator::Stats::toJson() const {
+    std::ostringstream json;
+    json << "{"
+         << "\"requested_bytes\": " << requestedBytes
+         << ", \"rounded_bytes\": " << roundedBytes
+         << ", \"internal_fragmentation\": " << internalFragmentation()
+         << ", \"allocated_bytes\": " << allocatedBytes
+         << ", \"peak_allocated_bytes\": " << peakAllocatedBytes
+         << ", \"pool_bytes\": " << poolBytes
+         << ", \"arena_count\": " << arenaCount
+         << ", \"largest_free_block\": " << largestFreeBlock
+         << ", \"cached_blocks\": " << cachedBlocks
+         << ", \"free_blocks\": {";
+    bool first = true;
+    for (size_t order = 0; order < freeBlocks.size(); ++order) {
+        if (freeBlocks[order] == 0) continue;
+        json << (first ? "" : ", ") << "\"" << (1ULL << order) << "\": " << freeBlocks[order];
+        first = false;
     }
+    json << "}"
+         << ", \"allocations\": " << allocations
+         << ", \"deallocations\": " << deallocations
+         << ", \"splits\": " << splits
+         << ", \"merges\": " << merges
+         << ", \"failed_allocations\": " << failedAllocations
+         << "}";
+    return json.str();
 }
 
-void BuddyAllocator::markBlockAvailable(size_t order, size_t blockIndex) {
-    if (order <= maxOrder && blockIndex < availableBlocks[order].size()) {
-        availableBlocks[order][blockIndex] = true;
+void BuddyAllocator::markBlockUnavailable(Arena& arena, size_t order, size_t blockIndex) {
+    arena.availableWords[arena.availableOffsets[order] + (blockIndex >> 6)] &= ~(1ULL << (blockIndex & 63));
+}
+
+void BuddyAllocator::markBlockAvailable(Arena& arena, size_t order, size_t blockIndex) {
+    arena.availableWords[arena.availableOffsets[order] + (blockIndex >> 6)] |= 1ULL << (blockIndex & 63);
+}
+
+bool BuddyAllocator::isBlockAvailable(const Arena& arena, size_t order, size_t blockIndex) const {
+    return (arena.availableWords[arena.availableOffsets[order] + (blockIndex >> 6)] >> (blockIndex & 63)) & 1;
+}
+
+void BuddyAllocator::pushFreeBlock(Arena& arena, size_t order, size_t blockIndex) {
+    FreeBlock* block = static_cast<FreeBlock*>(getBlockAddress(arena, order, blockIndex));
+    block->prev = nullptr;
+    block->next = arena.freeLists[order];
+    if (block->next) {
+        block->next->prev = block;
     }
+    arena.freeLists[order] = block;
+    markBlockAvailable(arena, order, blockIndex);
 }
 
-bool BuddyAllocator::isBlockAvailable(size_t order, size_t blockIndex) const {
-    if (order <= maxOrder && blockIndex < availableBlocks[order].size()) {
-        return availableBlocks[order][blockIndex];
+void BuddyAllocator::removeFreeBlock(Arena& arena, size_t order, size_t blockIndex) {
+    FreeBlock* block = static_cast<FreeBlock*>(getBlockAddress(arena, order, blockIndex));
+    if (block->prev) {
+        block->prev->next = block->next;
+    } else {
+        arena.freeLists[order] = block->next;
     }
-    return false;
+    if (block->next) {
+        block->next->prev = block->prev;
+    }
+    markBlockUnavailable(arena, order, blockIndex);
+}
+
+size_t BuddyAllocator::popFreeBlock(Arena& arena, size_t order) {
+    size_t offset = reinterpret_cast<char*>(arena.freeLists[order]) - arena.memoryPool;
+    size_t blockIndex = offset >> order;
+    removeFreeBlock(arena, order, blockIndex);
+    return blockIndex;
 }
 
-void BuddyAllocator::splitBlock(size_t order, size_t blockIndex) {
-    if (order <= 0) return;
-    
-    // Mark the current block as unavailable
-    markBlockUnavailable(order, blockIndex);
-    
-    // Calculate the indices of the two child blocks
-    size_t leftChildIndex = blockIndex * 2;
-    size_t rightChildIndex = leftChildIndex + 1;
-    
-    // Mark both children as available
-    markBlockAvailable(order - 1, leftChildIndex);
-    markBlockAvailable(order - 1, rightChildIndex);
+void BuddyAllocator::splitBlock(Arena& arena, size_t order, size_t blockIndex) {
+    if (order <= minOrder) return;
+
+    // The left child goes to the caller, the right child becomes free
+    splitCount++;
+    pushFreeBlock(arena, order - 1, blockIndex * 2 + 1);
 }
 
-void BuddyAllocator::mergeBlocks(size_t order, size_t blockIndex) {
-    if (order >= maxOrder) return;
-    
-    // Calculate parent block index
-    size_t parentIndex = blockIndex / 2;
-    
-    // Mark the parent block as available
-    markBlockAvailable(order + 1, parentIndex);
-    
-    // Mark both child blocks as unavailable
-    markBlockUnavailable(order, blockIndex);
-    markBlockUnavailable(order, blockIndex ^ 1);
+void BuddyAllocator::mergeBlocks(Arena& arena, size_t order, size_t blockIndex) {
+    if (order >= arena.maxOrder) return;
+
+    // Unlink the free buddy; the parent is pushed by the caller once merging stops
+    mergeCount++;
+    removeFreeBlock(arena, order, getBuddyIndex(blockIndex));
+    markBlockUnavailable(arena, order, blockIndex);
 }
 
 size_t BuddyAllocator::getBuddyIndex(size_t blockIndex) const {
     return blockIndex ^ 1; // XOR with 1 to get buddy index
 }
 
-void* BuddyAllocator::getBlockAddress(size_t order, size_t blockIndex) const {
-    size_t offset = blockIndex * getSizeForOrder(order);
-    return memoryPool + offset;
+void* BuddyAllocator::getBlockAddress(const Arena& arena, size_t order, size_t blockIndex) const {
+    size_t offset = blockIndex << order;
+    return arena.memoryPool + offset;
 }
 
-std::pair<size_t, size_t> BuddyAllocator::findBlock(void* ptr) const {
-    char* charPtr = static_cast<char*>(ptr);
-    size_t offset = charPtr - memoryPool;
-    
-    // Find the allocated block information
-    auto it = allocatedBlocks.find(ptr);
-    if (it != allocatedBlocks.end()) {
-        size_t order = it->second;
-        size_t blockSize = getSizeForOrder(order);
-        size_t blockIndex = offset / blockSize;
-        return {order, blockIndex};
+BuddyAllocator::BlockRef BuddyAllocator::findBlock(const void* ptr) const {
+    const char* charPtr = static_cast<const char*>(ptr);
+
+    // A live pointer's arena cannot be released, so a plain range scan is
+    // safe even while other threads grow or shrink the pool
+    size_t slotCount = arenaSlotCount.load(std::memory_order_acquire);
+    for (size_t i = 0; i < slotCount; ++i) {
+        Arena* arena = arenaSlots[i].load(std::memory_order_acquire);
+        if (!arena || charPtr < arena->memoryPool || charPtr >= arena->memoryPool + arena->poolSize) {
+            continue; // Not in this arena
+        }
+
+        size_t offset = charPtr - arena->memoryPool;
+        if (offset & (getSizeForOrder(minOrder) - 1)) {
+            break; // Not the start of a block
+        }
+
+        // Find the allocated block information
+        uint8_t entry = arena->blockOrders[offset >> minOrder];
+        size_t order = entry & ~cachedMark;
+        if (order == 0) {
+            break;
+        }
+        return {arena, order, offset >> order};
     }
-    
-    return {0, 0}; // Not found
-}
\ No newline at end of file
+
+    return {nullptr, 0, 0}; // Not found
+}
+
+uint8_t& BuddyAllocator::blockOrderEntry(const BlockRef& block) const {
+    return block.arena->blockOrders[(block.blockIndex << block.order) >> minOrder];
+}
@@ -3,54 +3,275 @@
 
 #include <cstddef>
 #include <vector>
-#include <unordered_map>
 #include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <string>
 
 class BuddyAllocator {
 public:
-    // Initialize allocator with 2^maxOrder bytes
-    BuddyAllocator(size_t maxOrder);
+    // How arena memory is backed
+    enum class PageMode {
+        Normal,          // Regular 4 KB pages
+        TransparentHuge, // madvise(MADV_HUGEPAGE) on every arena
+        ExplicitHuge     // MAP_HUGETLB, falling back to transparent huge pages
+    };
+
+    // Snapshot of allocator usage returned by stats()
+    struct Stats {
+        // Bytes callers asked for vs. bytes handed out after rounding to a
+        // block size, summed over every allocation so far
+        uint64_t requestedBytes;
+        uint64_t roundedBytes;
+
+        // Live block bytes (including thread caches) now and at the peak
+        size_t allocatedBytes;
+        size_t peakAllocatedBytes;
+
+        // Reserved memory
+        size_t poolBytes;
+        size_t arenaCount;
+
+        // Free blocks in the trees per order, and blocks parked in thread caches
+        std::vector<size_t> freeBlocks;
+        size_t cachedBlocks;
+
+        // Largest block that can be allocated without growing the pool
+        size_t largestFreeBlock;
+
+        // Operation counters
+        uint64_t allocations;
+        uint64_t deallocations;
+        uint64_t splits;
+        uint64_t merges;
+        uint64_t failedAllocations;
+
+        // Fraction of handed-out bytes lost to power-of-two rounding
+        double internalFragmentation() const;
+
+        // Serialize as a single JSON object
+        std::string toJson() const;
+    };
+
+    // Initialize allocator with an initial arena of 2^maxOrder bytes. A
+    // thread-safe allocator may be shared between threads; each thread keeps
+    // a small cache of recently freed blocks per order in front of the
+    // locked buddy tree.
+    BuddyAllocator(size_t maxOrder, bool threadSafe = false, PageMode pageMode = PageMode::Normal);
     ~BuddyAllocator();
-    
+
     // Allocate memory of given size
     void* allocate(size_t size);
-    
+
+    // Allocate memory whose address is a multiple of alignment (a power of
+    // two no larger than 2 MB); released with deallocate
+    void* allocateAligned(size_t size, size_t alignment);
+
     // Free allocated memory
     void deallocate(void* ptr);
-    
-    // Get total memory currently allocated
+
+    // Whether ptr is a live block handed out by this allocator
+    bool owns(const void* ptr) const;
+
+    // Bytes usable at ptr, a live block handed out by this allocator (its
+    // power-of-two block size), or 0 for any other pointer
+    size_t blockSize(const void* ptr) const;
+
+    // Get total memory currently allocated (including blocks parked in thread caches)
     size_t getTotalAllocated() const;
 
+    // Get total memory reserved by all arenas
+    size_t getPoolSize() const;
+
+    // Collect usage, fragmentation and operation statistics
+    Stats stats() const;
+
+    // Return every block held in thread caches to the buddy tree and release
+    // arenas left idle
+    void flushThreadCaches();
+
+    // Let the pool grow by adding power-of-two arenas until it reserves
+    // maxBytes in total (0 keeps the pool at its initial size)
+    void setPoolLimit(size_t maxBytes);
+
+    // Release grown arenas (and purge the pages of the initial one) once
+    // they have been empty for the given period. Expiry is checked on every
+    // call that reaches the buddy tree
+    void setIdleRelease(std::chrono::milliseconds period);
+
+    // Give arenas that are past their idle period back to the OS; owners
+    // that stop allocating call this while they wait
+    void releaseIdleArenas();
+
+    // Return the pages of freed blocks of at least this size to the OS as
+    // soon as they are freed (by default only idle arenas are purged)
+    void setPurgeThreshold(size_t bytes);
+
 private:
-    // Maximum order (power of 2) for the allocator
-    size_t maxOrder;
-    
-    // Total memory pool size (2^maxOrder)
+    // Smallest block handed out (2^minOrder bytes); must hold a FreeBlock
+    static const size_t minOrder = 4;
+
+    // Arenas are aligned to their size, up to one huge page
+    static const size_t hugePageSize = 2 * 1024 * 1024;
+
+    // Upper bound on simultaneously reserved arenas
+    static const size_t maxArenas = 64;
+
+    // Blocks each thread may keep per order before spilling back to the tree
+    static const size_t magazineSize = 8;
+
+    // Orders below this are cached per thread and refilled in batches of half
+    // a magazine; larger blocks (image buffers) go straight back to the tree,
+    // so they never keep an arena from going idle
+    static const size_t batchRefillOrder = 16;
+
+    // Set in a block's blockOrders entry while it sits in a thread cache
+    static const uint8_t cachedMark = 0x80;
+
+    // Free list node stored in the first bytes of every free block
+    struct FreeBlock {
+        FreeBlock* prev;
+        FreeBlock* next;
+    };
+
+    // One power-of-two buddy tree. Arenas are never deleted before the
+    // allocator so lock-free lookups may still read a released one.
+    struct Arena {
+        // Maximum order (power of 2) for this arena
+        size_t maxOrder;
+
+        // Arena size (2^maxOrder)
+        size_t poolSize;
+
+        // Base memory address (kept after release for lookups)
+        char* memoryPool;
+
+        // Size of the mapping behind memoryPool
+        size_t mappedSize;
+
+        // Whether the memory has been given back
+        bool released;
+
+        // Availability bitmap of every level packed into 64-bit words;
+        // level k starts at word availableOffsets[k]
+        std::vector<uint64_t> availableWords;
+        std::vector<size_t> availableOffsets;
+
+        // Head of the intrusive list of free blocks at each level
+        std::vector<FreeBlock*> freeLists;
+
+        // Order of the live block starting at each minimum-size block (0 =
+        // none), plus cachedMark while the block is parked in a thread cache
+        std::vector<uint8_t> blockOrders;
+
+        // Memory currently allocated from this arena
+        size_t allocated;
+
+        // When the arena last became empty
+        std::chrono::steady_clock::time_point emptySince;
+
+        // Empty and waiting for its idle period to pass
+        bool idle;
+    };
+
+    // A live block located by findBlock (arena is nullptr if not found)
+    struct BlockRef {
+        Arena* arena;
+        size_t order;
+        size_t blockIndex;
+    };
+
+    // Counters updated on every allocate/deallocate call
+    struct UsageCounters {
+        uint64_t allocations;
+        uint64_t deallocations;
+        uint64_t failedAllocations;
+        uint64_t requestedBytes;
+        uint64_t roundedBytes;
+    };
+
+    // Per-thread magazines of free blocks, one per order
+    struct ThreadCache {
+        std::thread::id owner;
+        std::mutex lock;
+        UsageCounters usage;
+        size_t counts[64];
+        void* blocks[64][magazineSize];
+    };
+
+    // Order of the initial arena, which is never released
+    size_t initialOrder;
+
+    // Growth limits
+    size_t poolLimit;
+    std::chrono::milliseconds idleRelease;
+
+    // Backing pages and when freed memory goes back to the OS
+    PageMode pageMode;
+    size_t purgeThreshold;
+
+    // Memory reserved by all live arenas
     size_t poolSize;
-    
-    // Base memory address
-    char* memoryPool;
-    
-    // Represents the availability status of blocks at each level
-    std::vector<std::vector<bool>> availableBlocks;
-    
-    // Map of allocated pointers to their sizes (for deallocation)
-    std::unordered_map<void*, size_t> allocatedBlocks;
-    
+
+    // Live arenas in preference order (slot 0 is the initial arena)
+    std::atomic<Arena*> arenaSlots[maxArenas];
+
+    // Number of slots that have ever been used
+    std::atomic<size_t> arenaSlotCount;
+
+    // Owns every arena ever created, including released ones
+    std::vector<std::unique_ptr<Arena>> arenaStorage;
+
+    // Arenas that are currently idle
+    size_t emptyArenas;
+
     // Total memory currently allocated
     size_t totalAllocated;
-    
+
+    // Statistics kept by the trees; calls in concurrent mode count in the
+    // thread caches instead of usage
+    size_t peakAllocated;
+    uint64_t splitCount;
+    uint64_t mergeCount;
+    UsageCounters usage;
+
+    // Concurrent mode: poolMutex guards the trees and the cache registry
+    bool threadSafe;
+    uint64_t allocatorId;
+    mutable std::mutex poolMutex;
+    std::vector<std::unique_ptr<ThreadCache>> threadCaches;
+
     // Helper functions
+    void* allocateBlock(size_t order, bool mayGrow = true);
+    void* allocateFromArena(Arena& arena, size_t order);
+    void releaseBlock(const BlockRef& block);
+    Arena* createArena(size_t order);
+    void destroyArena(Arena& arena);
+    void purgeBlock(Arena& arena, size_t order, size_t blockIndex);
+    Arena* growPool(size_t order);
+    void releaseIdleArenasLocked();
+    ThreadCache* getThreadCache();
+    void flushThreadCachesLocked();
+    void* allocateCached(size_t order, size_t size);
+    void recordAllocation(UsageCounters& counters, size_t size, size_t order, bool succeeded);
+    void deallocateCached(void* ptr, const BlockRef& block);
+    uint8_t& blockOrderEntry(const BlockRef& block) const;
     size_t getSizeForOrder(size_t order) const;
     size_t getOrderForSize(size_t size) const;
-    void markBlockUnavailable(size_t order, size_t blockIndex);
-    void markBlockAvailable(size_t order, size_t blockIndex);
-    bool isBlockAvailable(size_t order, size_t blockIndex) const;
-    void splitBlock(size_t order, size_t blockIndex);
-    void mergeBlocks(size_t order, size_t blockIndex);
+    void markBlockUnavailable(Arena& arena, size_t order, size_t blockIndex);
+    void markBlockAvailable(Arena& arena, size_t order, size_t blockIndex);
+    bool isBlockAvailable(const Arena& arena, size_t order, size_t blockIndex) const;
+    void pushFreeBlock(Arena& arena, size_t order, size_t blockIndex);
+    void removeFreeBlock(Arena& arena, size_t order, size_t blockIndex);
+    size_t popFreeBlock(Arena& arena, size_t order);
+    void splitBlock(Arena& arena, size_t order, size_t blockIndex);
+    void mergeBlocks(Arena& arena, size_t order, size_t blockIndex);
     size_t getBuddyIndex(size_t blockIndex) const;
-    void* getBlockAddress(size_t order, size_t blockIndex) const;
-    std::pair<size_t, size_t> findBlock(void* ptr) const;
+    void* getBlockAddress(const Arena& arena, size_t order, size_t blockIndex) const;
+    BlockRef findBlock(const void* ptr) const;
 };
 
 #endif // BUDDY_ALLOCATOR_H
\ No newline at end of file
@@ -0,0 +1,32 @@
+#include "buddy_memory_resource.h"
+
+BuddyMemoryResource::BuddyMemoryResource(BuddyAllocator* allocator, std::pmr::memory_resource* upstream)
+    : allocator(allocator), upstream(upstream) {
+}
+
+BuddyAllocator* BuddyMemoryResource::getAllocator() const {
+    return allocator;
+}
+
+void* BuddyMemoryResource::do_allocate(std::size_t bytes, std::size_t alignment) {
+    void* ptr = allocator->allocateAligned(bytes, alignment);
+    if (ptr) {
+        return ptr;
+    }
+
+    // Pool exhausted or alignment beyond what buddy blocks guarantee
+    return upstream->allocate(bytes, alignment);
+}
+
+void BuddyMemoryResource::do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) {
+    if (allocator->owns(ptr)) {
+        allocator->deallocate(ptr);
+    } else {
+        upstream->deallocate(ptr, bytes, alignment);
+    }
+}
+
+bool BuddyMemoryResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    const BuddyMemoryResource* resource = dynamic_cast<const BuddyMemoryResource*>(&other);
+    return resource && resource->allocator == allocator && resource->upstream == upstream;
+}
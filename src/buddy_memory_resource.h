@@ -0,0 +1,72 @@
+#ifndef BUDDY_MEMORY_RESOURCE_H
+#define BUDDY_MEMORY_RESOURCE_H
+
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+#include "buddy_allocator.h"
+
+// std::pmr adaptor so pmr containers can draw from a BuddyAllocator. When the
+// pool cannot satisfy a request the upstream resource is used instead (by
+// default none, so std::bad_alloc is thrown).
+class BuddyMemoryResource : public std::pmr::memory_resource {
+public:
+    explicit BuddyMemoryResource(BuddyAllocator* allocator,
+                                 std::pmr::memory_resource* upstream = std::pmr::null_memory_resource());
+
+    BuddyAllocator* getAllocator() const;
+
+private:
+    BuddyAllocator* allocator;
+    std::pmr::memory_resource* upstream;
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+};
+
+// Typed allocator for standard containers backed by a BuddyAllocator
+template <typename T>
+class BuddyStlAllocator {
+public:
+    using value_type = T;
+
+    explicit BuddyStlAllocator(BuddyAllocator* allocator) noexcept : allocator(allocator) {}
+
+    template <typename U>
+    BuddyStlAllocator(const BuddyStlAllocator<U>& other) noexcept : allocator(other.getAllocator()) {}
+
+    T* allocate(std::size_t n) {
+        if (n > static_cast<std::size_t>(-1) / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        void* ptr = allocator->allocateAligned(n * sizeof(T), alignof(T));
+        if (!ptr) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(ptr);
+    }
+
+    void deallocate(T* ptr, std::size_t) noexcept {
+        allocator->deallocate(ptr);
+    }
+
+    BuddyAllocator* getAllocator() const noexcept {
+        return allocator;
+    }
+
+private:
+    BuddyAllocator* allocator;
+};
+
+template <typename T, typename U>
+bool operator==(const BuddyStlAllocator<T>& a, const BuddyStlAllocator<U>& b) noexcept {
+    return a.getAllocator() == b.getAllocator();
+}
+
+template <typename T, typename U>
+bool operator!=(const BuddyStlAllocator<T>& a, const BuddyStlAllocator<U>& b) noexcept {
+    return !(a == b);
+}
+
+#endif // BUDDY_MEMORY_RESOURCE_H
@@ -2,6 +2,187 @@
 #include <iostream>
 #include <cmath>
 #include <cstring>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <memory>
+#include <new>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+// Allocator the decoder on this thread draws from; nullptr means new/delete,
+// matching ImageProcessor's conventional mode so decoded buffers can be
+// adopted as image data without a copy
+thread_local BuddyAllocator* decodeAllocator = nullptr;
+
+// Routes stb_image allocations to an allocator for the lifetime of the scope
+struct DecodeAllocatorScope {
+    BuddyAllocator* previous;
+
+    explicit DecodeAllocatorScope(BuddyAllocator* allocator) : previous(decodeAllocator) {
+        decodeAllocator = allocator;
+    }
+
+    ~DecodeAllocatorScope() {
+        decodeAllocator = previous;
+    }
+};
+
+void* decodeMalloc(size_t size) {
+    if (decodeAllocator) {
+        return decodeAllocator->allocate(size);
+    }
+    return new (std::nothrow) unsigned char[size];
+}
+
+void decodeFree(void* ptr) {
+    if (decodeAllocator) {
+        decodeAllocator->deallocate(ptr);
+    } else {
+        delete[] static_cast<unsigned char*>(ptr);
+    }
+}
+
+void* decodeRealloc(void* ptr, size_t oldSize, size_t newSize) {
+    // Buddy blocks are rounded up to a power of two, so a growing buffer
+    // often still fits the block it already has
+    if (decodeAllocator && ptr && newSize <= decodeAllocator->blockSize(ptr)) {
+        return ptr;
+    }
+
+    void* resized = decodeMalloc(newSize);
+    if (resized && ptr) {
+        std::memcpy(resized, ptr, std::min(oldSize, newSize));
+        decodeFree(ptr);
+    }
+    return resized;
+}
+
+// Formats are matched case-insensitively, so photo.JPG saves as "jpg"
+std::string lowercase(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+    return text;
+}
+
+// The codecs read and write a few bytes to a few kilobytes at a time; files
+// and pipes are accessed in blocks of this size instead
+const size_t streamBufferBytes = size_t(1) << 20;
+
+// stb_image read callbacks over a file descriptor
+struct DescriptorReader {
+    int fd;
+    std::unique_ptr<char[]> buffer;
+    size_t position;
+    size_t size;
+    bool ended;
+
+    // errno of a failed read, or 0
+    int error;
+
+    explicit DescriptorReader(int descriptor)
+        : fd(descriptor), buffer(new char[streamBufferBytes]), position(0), size(0), ended(false), error(0) {
+    }
+
+    // Read the next block; false at end of input or on error
+    bool refill() {
+        if (ended) {
+            return false;
+        }
+        ssize_t received;
+        do {
+            received = ::read(fd, buffer.get(), streamBufferBytes);
+        } while (received < 0 && errno == EINTR);
+        position = 0;
+        size = received > 0 ? static_cast<size_t>(received) : 0;
+        ended = received <= 0;
+        error = received < 0 ? errno : 0;
+        return !ended;
+    }
+
+    static int read(void* user, char* data, int count) {
+        DescriptorReader& reader = *static_cast<DescriptorReader*>(user);
+        int copied = 0;
+        while (copied < count && (reader.position < reader.size || reader.refill())) {
+            size_t chunk = std::min(static_cast<size_t>(count - copied), reader.size - reader.position);
+            std::memcpy(data + copied, reader.buffer.get() + reader.position, chunk);
+            reader.position += chunk;
+            copied += static_cast<int>(chunk);
+        }
+        return copied;
+    }
+
+    // stb_image only skips forward on callback streams
+    static void skip(void* user, int count) {
+        DescriptorReader& reader = *static_cast<DescriptorReader*>(user);
+        size_t remaining = count > 0 ? static_cast<size_t>(count) : 0;
+        while (remaining > 0 && (reader.position < reader.size || reader.refill())) {
+            size_t chunk = std::min(remaining, reader.size - reader.position);
+            reader.position += chunk;
+            remaining -= chunk;
+        }
+    }
+
+    static int eof(void* user) {
+        DescriptorReader& reader = *static_cast<DescriptorReader*>(user);
+        return reader.position == reader.size && !reader.refill();
+    }
+};
+
+// Collects encoder output and writes it to a file descriptor in large blocks
+struct DescriptorWriter {
+    int fd;
+    std::unique_ptr<char[]> buffer;
+    size_t used;
+
+    // errno of a failed write, or 0
+    int error;
+
+    explicit DescriptorWriter(int descriptor)
+        : fd(descriptor), buffer(new char[streamBufferBytes]), used(0), error(0) {
+    }
+
+    void writeAll(const char* data, size_t size) {
+        while (size > 0 && error == 0) {
+            ssize_t written = ::write(fd, data, size);
+            if (written < 0) {
+                error = errno == EINTR ? 0 : errno;
+                continue;
+            }
+            data += written;
+            size -= written;
+        }
+    }
+
+    bool flush() {
+        writeAll(buffer.get(), used);
+        used = 0;
+        return error == 0;
+    }
+
+    // stbi_write_func; chunks larger than the buffer bypass it
+    static void write(void* context, void* data, int size) {
+        DescriptorWriter& writer = *static_cast<DescriptorWriter*>(context);
+        size_t count = static_cast<size_t>(size);
+        if (writer.used + count > streamBufferBytes) {
+            writer.flush();
+        }
+        if (count >= streamBufferBytes) {
+            writer.writeAll(static_cast<const char*>(data), count);
+        } else {
+            std::memcpy(writer.buffer.get() + writer.used, data, count);
+            writer.used += count;
+        }
+    }
+};
+
+} // namespace
+
+#define STBI_MALLOC(size) decodeMalloc(size)
+#define STBI_REALLOC_SIZED(ptr, oldSize, newSize) decodeRealloc(ptr, oldSize, newSize)
+#define STBI_FREE(ptr) decodeFree(ptr)
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #define STB_IMAGE_WRITE_IMPLEMENTATION
@@ -9,212 +190,422 @@
 
 const double PI = 3.14159265358979323846;
 
+// Angles this close (in degrees) to a multiple of 90 take the exact path
+const double quarterTurnTolerance = 1e-6;
+
+const size_t ImageProcessor::rowAlignment;
+const int ImageProcessor::maxDimension;
+
 ImageProcessor::ImageProcessor(bool useBuddySystem, BuddyAllocator* allocator)
-    : imageData(nullptr), width(0), height(0), channels(0),
-      useBuddySystem(useBuddySystem), allocator(allocator) {
+    : imageData(nullptr), width(0), height(0), channels(0), stride(0),
+      useBuddySystem(useBuddySystem), allocator(allocator),
+      interpolation(Interpolation::FixedPoint), rotationMode(RotationMode::Bilinear), threadPool(nullptr) {
 }
 
 ImageProcessor::~ImageProcessor() {
     deallocateImage();
 }
 
-void ImageProcessor::allocateImage(int w, int h, int c) {
-    deallocateImage();
-    width = w;
-    height = h;
-    channels = c;
+void ImageProcessor::deallocateImage() {
+    if (imageData) {
+        freeBuffer(imageData);
+        imageData = nullptr;
+    }
+}
+
+size_t ImageProcessor::rowPitch(int w, int c) {
+    size_t rowBytes = static_cast<size_t>(w) * c * sizeof(unsigned char);
+    return (rowBytes + rowAlignment - 1) & ~(rowAlignment - 1);
+}
+
+unsigned char* ImageProcessor::allocateBuffer(size_t size) {
+    if (useBuddySystem && allocator) {
+        unsigned char* buffer = static_cast<unsigned char*>(allocator->allocateAligned(size, rowAlignment));
+        if (!buffer) {
+            std::cerr << "Buddy pool exhausted allocating " << size << " bytes" << std::endl;
+        }
+        return buffer;
+    }
+    unsigned char* buffer = new (std::nothrow) unsigned char[size];
+    if (!buffer) {
+        std::cerr << "Out of memory allocating " << size << " bytes" << std::endl;
+    }
+    return buffer;
+}
 
-    size_t size = width * height * channels * sizeof(unsigned char);
+void ImageProcessor::freeBuffer(unsigned char* buffer) {
     if (useBuddySystem && allocator) {
-        imageData = static_cast<unsigned char*>(allocator->allocate(size));
+        allocator->deallocate(buffer);
     } else {
-        imageData = new unsigned char[size];
+        delete[] buffer;
     }
 }
 
-void ImageProcessor::deallocateImage() {
-    if (imageData) {
-        if (useBuddySystem && allocator) {
-            allocator->deallocate(imageData);
-        } else {
-            delete[] imageData;
+bool ImageProcessor::loadImage(const std::string& filename) {
+    deallocateImage();
+
+    // The decoder allocates its output from our allocator, so the decoded
+    // (tightly packed) buffer becomes the image data as is
+    int w, h, c;
+    unsigned char* loadedData;
+    if (filename == "-") {
+        DescriptorReader reader(STDIN_FILENO);
+        stbi_io_callbacks callbacks = {DescriptorReader::read, DescriptorReader::skip, DescriptorReader::eof};
+        DecodeAllocatorScope scope(useBuddySystem ? allocator : nullptr);
+        loadedData = stbi_load_from_callbacks(&callbacks, &reader, &w, &h, &c, 0);
+        if (reader.error != 0) {
+            std::cerr << "Failed to read standard input: " << std::strerror(reader.error) << std::endl;
         }
-        imageData = nullptr;
+        return adoptDecoded(loadedData, w, h, c, "standard input");
+    }
+    {
+        DecodeAllocatorScope scope(useBuddySystem ? allocator : nullptr);
+        loadedData = stbi_load(filename.c_str(), &w, &h, &c, 0);
     }
+    return adoptDecoded(loadedData, w, h, c, filename);
 }
 
-bool ImageProcessor::loadImage(const std::string& filename) {
+bool ImageProcessor::loadImageFromMemory(const unsigned char* bytes, size_t size) {
     deallocateImage();
 
+    if (size > static_cast<size_t>(INT_MAX)) {
+        std::cerr << "Failed to load image: encoded data too large" << std::endl;
+        return false;
+    }
+
     int w, h, c;
-    unsigned char* loadedData = stbi_load(filename.c_str(), &w, &h, &c, 0);
-    if (!loadedData) {
-        std::cerr << "Failed to load image: " << filename << std::endl;
+    unsigned char* loadedData;
+    {
+        DecodeAllocatorScope scope(useBuddySystem ? allocator : nullptr);
+        loadedData = stbi_load_from_memory(bytes, static_cast<int>(size), &w, &h, &c, 0);
+    }
+    return adoptDecoded(loadedData, w, h, c, "memory");
+}
+
+bool ImageProcessor::adoptDecoded(unsigned char* decoded, int w, int h, int c, const std::string& source) {
+    if (!decoded) {
+        std::cerr << "Failed to load image: " << source << " (" << stbi_failure_reason() << ")" << std::endl;
         return false;
     }
 
-    allocateImage(w, h, c);
-    std::memcpy(imageData, loadedData, w * h * c * sizeof(unsigned char));
-    stbi_image_free(loadedData);
+    imageData = decoded;
+    width = w;
+    height = h;
+    channels = c;
+    stride = static_cast<size_t>(w) * c * sizeof(unsigned char);
     return true;
 }
 
-bool ImageProcessor::saveImage(const std::string& filename) {
+bool ImageProcessor::saveImage(const std::string& filename, const std::string& format) {
+    bool toStdout = filename == "-";
+    std::string chosenFormat = lowercase(format);
+    if (chosenFormat.empty()) {
+        size_t dotPos = filename.find_last_of('.');
+        if (toStdout || dotPos == std::string::npos) {
+            std::cerr << (toStdout ? "Output format required for standard output" : "Unknown file extension") << std::endl;
+            return false;
+        }
+        chosenFormat = lowercase(filename.substr(dotPos + 1));
+    }
+
+    // Check before opening so a bad name leaves no empty file behind
+    if (!isSupportedFormat(chosenFormat)) {
+        std::cerr << "Unsupported file format: " << chosenFormat << std::endl;
+        return false;
+    }
+
+    int fd = toStdout ? STDOUT_FILENO : ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd < 0) {
+        std::cerr << "Failed to open " << filename << " for writing" << std::endl;
+        return false;
+    }
+
+    DescriptorWriter writer(fd);
+    bool success = writeImage(chosenFormat, DescriptorWriter::write, &writer);
+    if (!writer.flush()) {
+        std::cerr << "Failed to write " << (toStdout ? "standard output" : filename) << ": " << std::strerror(writer.error) << std::endl;
+        success = false;
+    }
+    if (!toStdout && ::close(fd) != 0) {
+        success = false;
+    }
+    return success;
+}
+
+bool ImageProcessor::encodeImage(const std::string& format, std::vector<unsigned char>& encoded) {
+    encoded.clear();
+    auto append = [](void* context, void* data, int size) {
+        std::vector<unsigned char>& output = *static_cast<std::vector<unsigned char>*>(context);
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        output.insert(output.end(), bytes, bytes + size);
+    };
+    return writeImage(lowercase(format), append, &encoded);
+}
+
+bool ImageProcessor::writeImage(const std::string& format, WriteCallback* write, void* context) {
     if (!imageData) {
         std::cerr << "No image data to save" << std::endl;
         return false;
     }
 
-    size_t dotPos = filename.find_last_of('.');
-    if (dotPos == std::string::npos) {
-        std::cerr << "Unknown file extension" << std::endl;
+    if (!isSupportedFormat(format)) {
+        std::cerr << "Unsupported file format: " << format << std::endl;
         return false;
     }
 
-    std::string ext = filename.substr(dotPos + 1);
-    bool success = false;
+    // PNG takes a row stride; the other writers need tightly packed rows
+    size_t rowBytes = static_cast<size_t>(width) * channels * sizeof(unsigned char);
+    if (format == "png") {
+        return stbi_write_png_to_func(write, context, width, height, channels, imageData,
+                                      static_cast<int>(stride)) != 0;
+    }
+
+    unsigned char* packed = imageData;
+    if (stride != rowBytes) {
+        packed = allocateBuffer(rowBytes * height);
+        if (!packed) {
+            return false;
+        }
+        for (int y = 0; y < height; y++) {
+            std::memcpy(packed + y * rowBytes, imageData + y * stride, rowBytes);
+        }
+    }
 
-    if (ext == "jpg" || ext == "jpeg") {
-        success = stbi_write_jpg(filename.c_str(), width, height, channels, imageData, 95) != 0;
-    } else if (ext == "png") {
-        success = stbi_write_png(filename.c_str(), width, height, channels, imageData, width * channels) != 0;
-    } else if (ext == "bmp") {
-        success = stbi_write_bmp(filename.c_str(), width, height, channels, imageData) != 0;
+    bool success;
+    if (format == "bmp") {
+        success = stbi_write_bmp_to_func(write, context, width, height, channels, packed) != 0;
     } else {
-        std::cerr << "Unsupported file format: " << ext << std::endl;
-        return false;
+        success = stbi_write_jpg_to_func(write, context, width, height, channels, packed, 95) != 0;
     }
 
+    if (packed != imageData) {
+        freeBuffer(packed);
+    }
     return success;
 }
 
+void ImageProcessor::setInterpolation(Interpolation mode) {
+    interpolation = mode;
+}
+
+void ImageProcessor::setRotationMode(RotationMode mode) {
+    rotationMode = mode;
+}
+
+void ImageProcessor::setThreadPool(ThreadPool* pool) {
+    threadPool = pool;
+}
+
 void ImageProcessor::getImageInfo(int& w, int& h, int& c) {
     w = width;
     h = height;
     c = channels;
 }
 
-unsigned char* ImageProcessor::getPixel(unsigned char* data, int x, int y, int c, int w, int h) {
-    if (x < 0) x = 0;
-    if (x >= w) x = w - 1;
-    if (y < 0) y = 0;
-    if (y >= h) y = h - 1;
+void ImageProcessor::clear() {
+    deallocateImage();
+    width = 0;
+    height = 0;
+    channels = 0;
+    stride = 0;
+}
 
-    return &data[(y * w + x) * channels + c];
+bool ImageProcessor::isSupportedFormat(const std::string& format) {
+    std::string lower = lowercase(format);
+    return lower == "jpg" || lower == "jpeg" || lower == "png" || lower == "bmp";
 }
 
-void ImageProcessor::setPixel(unsigned char* data, int x, int y, int c, unsigned char value, int w, int h) {
-    if (x >= 0 && x < w && y >= 0 && y < h) {
-        data[(y * w + x) * channels + c] = value;
+// False, with a message, when factor is not a positive finite number or a
+// side of the result would fall outside [1, maxDimension]
+bool ImageProcessor::scaledSize(int w, int h, double factor, int& scaledWidth, int& scaledHeight) {
+    double roundedWidth = std::round(w * factor);
+    double roundedHeight = std::round(h * factor);
+    if (!(roundedWidth >= 1 && roundedHeight >= 1 && roundedWidth <= maxDimension && roundedHeight <= maxDimension)) {
+        std::cerr << "Scale factor " << factor << " gives an image size out of range" << std::endl;
+        return false;
     }
+    scaledWidth = static_cast<int>(roundedWidth);
+    scaledHeight = static_cast<int>(roundedHeight);
+    return true;
 }
 
-unsigned char ImageProcessor::bilinearInterpolation(unsigned char* data, double x, double y, int c, int w, int h) {
-    int x1 = static_cast<int>(x);
-    int y1 = static_cast<int>(y);
-    int x2 = x1 + 1;
-    int y2 = y1 + 1;
+// The kernels allocate scratch space (span tables, row caches, shear
+// planes) with new; running out of it frees buffer and fails the operation
+// instead of unwinding through the caller
+bool ImageProcessor::runKernel(unsigned char* buffer, const std::function<void()>& kernel) {
+    try {
+        kernel();
+        return true;
+    } catch (const std::bad_alloc&) {
+        freeBuffer(buffer);
+        std::cerr << "Out of memory for resampling scratch space" << std::endl;
+        return false;
+    }
+}
 
-    double xFrac = x - x1;
-    double yFrac = y - y1;
+void ImageProcessor::rotatedSize(double angle, int w, int h, int& rotatedWidth, int& rotatedHeight) {
+    double radians = angle * PI / 180.0;
+    double absAngleCos = std::abs(std::cos(radians));
+    double absAngleSin = std::abs(std::sin(radians));
+    rotatedWidth = static_cast<int>(w * absAngleCos + h * absAngleSin);
+    rotatedHeight = static_cast<int>(w * absAngleSin + h * absAngleCos);
+}
 
-    unsigned char p1 = *getPixel(data, x1, y1, c, w, h);
-    unsigned char p2 = *getPixel(data, x2, y1, c, w, h);
-    unsigned char p3 = *getPixel(data, x1, y2, c, w, h);
-    unsigned char p4 = *getPixel(data, x2, y2, c, w, h);
+// Number of quarter turns (0-3) angle is equivalent to, or -1 when it is not
+// a multiple of 90 degrees
+int ImageProcessor::quarterTurns(double angle) {
+    double turns = angle / 90.0;
+    double nearest = std::round(turns);
+    if (std::abs(turns - nearest) * 90.0 > quarterTurnTolerance) return -1;
+    int wrapped = static_cast<int>(std::fmod(nearest, 4.0));
+    return wrapped < 0 ? wrapped + 4 : wrapped;
+}
 
-    double top = p1 * (1 - xFrac) + p2 * xFrac;
-    double bottom = p3 * (1 - xFrac) + p4 * xFrac;
-    double result = top * (1 - yFrac) + bottom * yFrac;
+bool ImageProcessor::rotateQuarterTurns(int turns) {
+    if (turns == 0) return true;
 
-    return static_cast<unsigned char>(result);
-}
+    ImageView source = {imageData, width, height, channels, stride};
+    if (turns == 2) {
+        rotateHalfTurn(source, threadPool);
+        return true;
+    }
 
-void ImageProcessor::rotateImage(double angle) {
-    if (!imageData) return;
+    size_t newStride = rowPitch(height, channels);
+    unsigned char* rotatedData = allocateBuffer(newStride * width);
+    if (!rotatedData) {
+        return false;
+    }
 
-    double radians = angle * PI / 180.0;
-    double cosA = std::cos(radians);
-    double sinA = std::sin(radians);
+    ImageView target = {rotatedData, height, width, channels, newStride};
+    ::rotateQuarterTurns(source, target, turns, threadPool);
 
-    double absAngleCos = std::abs(cosA);
-    double absAngleSin = std::abs(sinA);
-    int newWidth = static_cast<int>(width * absAngleCos + height * absAngleSin);
-    int newHeight = static_cast<int>(width * absAngleSin + height * absAngleCos);
+    deallocateImage();
+    imageData = rotatedData;
+    std::swap(width, height);
+    stride = newStride;
+    return true;
+}
 
-    size_t newSize = newWidth * newHeight * channels * sizeof(unsigned char);
-    unsigned char* rotatedData;
+bool ImageProcessor::rotateImage(double angle) {
+    if (!imageData || !std::isfinite(angle)) return false;
 
-    if (useBuddySystem && allocator) {
-        rotatedData = static_cast<unsigned char*>(allocator->allocate(newSize));
-    } else {
-        rotatedData = new unsigned char[newSize];
+    int turns = quarterTurns(angle);
+    if (turns >= 0) {
+        return rotateQuarterTurns(turns);
     }
 
-    std::memset(rotatedData, 0, newSize);
+    int newWidth, newHeight;
+    rotatedSize(angle, width, height, newWidth, newHeight);
 
-    double oldCenterX = width / 2.0;
-    double oldCenterY = height / 2.0;
-    double newCenterX = newWidth / 2.0;
-    double newCenterY = newHeight / 2.0;
-
-    for (int y = 0; y < newHeight; y++) {
-        for (int x = 0; x < newWidth; x++) {
-            double xRel = x - newCenterX;
-            double yRel = y - newCenterY;
-
-            double xOld = xRel * cosA + yRel * sinA + oldCenterX;
-            double yOld = -xRel * sinA + yRel * cosA + oldCenterY;
-
-            if (xOld >= 0 && xOld <= width - 1 && yOld >= 0 && yOld <= height - 1) {
-                for (int c = 0; c < channels; c++) {
-                    unsigned char value = bilinearInterpolation(imageData, xOld, yOld, c, width, height);
-                    setPixel(rotatedData, x, y, c, value, newWidth, newHeight);
-                }
-            }
+    size_t newStride = rowPitch(newWidth, channels);
+    size_t newSize = newStride * newHeight;
+    unsigned char* rotatedData = allocateBuffer(newSize);
+    if (!rotatedData) {
+        return false;
+    }
+
+    ImageView source = {imageData, width, height, channels, stride};
+    ImageView target = {rotatedData, newWidth, newHeight, channels, newStride};
+    bool rotated = runKernel(rotatedData, [&] {
+        if (rotationMode == RotationMode::Shear) {
+            rotateShear(source, target, angle, threadPool);
+        } else {
+            rotateBilinear(source, target, angle, interpolation, threadPool);
         }
+    });
+    if (!rotated) {
+        return false;
     }
 
     deallocateImage();
     imageData = rotatedData;
     width = newWidth;
     height = newHeight;
+    stride = newStride;
+    return true;
 }
 
-void ImageProcessor::scaleImage(double factor) {
-    if (!imageData || factor <= 0) return;
-
-    int newWidth = static_cast<int>(std::round(width * factor));
-    int newHeight = static_cast<int>(std::round(height * factor));
+bool ImageProcessor::scaleImage(double factor) {
+    int newWidth, newHeight;
+    if (!imageData || !scaledSize(width, height, factor, newWidth, newHeight)) return false;
 
-    size_t newSize = newWidth * newHeight * channels * sizeof(unsigned char);
-    unsigned char* scaledData;
+    size_t newStride = rowPitch(newWidth, channels);
+    size_t newSize = newStride * newHeight;
+    unsigned char* scaledData = allocateBuffer(newSize);
+    if (!scaledData) {
+        return false;
+    }
 
-    if (useBuddySystem && allocator) {
-        scaledData = static_cast<unsigned char*>(allocator->allocate(newSize));
-    } else {
-        scaledData = new unsigned char[newSize];
+    ImageView source = {imageData, width, height, channels, stride};
+    ImageView target = {scaledData, newWidth, newHeight, channels, newStride};
+    if (!runKernel(scaledData, [&] { scaleBilinear(source, target, interpolation, threadPool); })) {
+        return false;
     }
 
-    std::memset(scaledData, 0, newSize);
+    deallocateImage();
+    imageData = scaledData;
+    width = newWidth;
+    height = newHeight;
+    stride = newStride;
+    return true;
+}
 
-    double xRatio = width / static_cast<double>(newWidth);
-    double yRatio = height / static_cast<double>(newHeight);
+bool ImageProcessor::warpAffine(const AffineMatrix& matrix, int newWidth, int newHeight) {
+    if (!imageData || newWidth <= 0 || newHeight <= 0 || newWidth > maxDimension || newHeight > maxDimension) {
+        return false;
+    }
 
-    for (int y = 0; y < newHeight; y++) {
-        for (int x = 0; x < newWidth; x++) {
-            double xOld = x * xRatio;
-            double yOld = y * yRatio;
+    size_t newStride = rowPitch(newWidth, channels);
+    size_t newSize = newStride * newHeight;
+    unsigned char* warpedData = allocateBuffer(newSize);
+    if (!warpedData) {
+        return false;
+    }
 
-            for (int c = 0; c < channels; c++) {
-                unsigned char value = bilinearInterpolation(imageData, xOld, yOld, c, width, height);
-                setPixel(scaledData, x, y, c, value, newWidth, newHeight);
-            }
-        }
+    ImageView source = {imageData, width, height, channels, stride};
+    ImageView target = {warpedData, newWidth, newHeight, channels, newStride};
+    if (!runKernel(warpedData, [&] { warpBilinear(source, target, matrix, interpolation, threadPool); })) {
+        return false;
     }
 
     deallocateImage();
-    imageData = scaledData;
+    imageData = warpedData;
     width = newWidth;
     height = newHeight;
+    stride = newStride;
+    return true;
+}
+
+bool ImageProcessor::rotateAndScale(double angle, double factor) {
+    if (!imageData || !std::isfinite(angle) || !std::isfinite(factor) || factor <= 0) return false;
+
+    // The exact rotation already avoids a resample, so only the scale is
+    // left; shear rotations cannot be folded into an affine warp
+    if (quarterTurns(angle) >= 0 || rotationMode == RotationMode::Shear) {
+        return rotateImage(angle) && scaleImage(factor);
+    }
+
+    int rotatedWidth, rotatedHeight;
+    rotatedSize(angle, width, height, rotatedWidth, rotatedHeight);
+    if (rotatedWidth <= 0 || rotatedHeight <= 0) return false;
+
+    int newWidth, newHeight;
+    if (!scaledSize(rotatedWidth, rotatedHeight, factor, newWidth, newHeight)) return false;
+
+    // Rotate about the source centre into the rotated frame, centred like
+    // rotateImage's output, then stretch that frame to the final size as
+    // scaleImage does
+    double radians = angle * PI / 180.0;
+    double cosA = std::cos(radians);
+    double sinA = std::sin(radians);
+    double sx = newWidth / static_cast<double>(rotatedWidth);
+    double sy = newHeight / static_cast<double>(rotatedHeight);
+    double oldCenterX = width / 2.0;
+    double oldCenterY = height / 2.0;
+    double rotatedCenterX = rotatedWidth / 2.0;
+    double rotatedCenterY = rotatedHeight / 2.0;
+
+    AffineMatrix matrix = {{sx * cosA, -sx * sinA, sx * (rotatedCenterX - cosA * oldCenterX + sinA * oldCenterY),
+                            sy * sinA, sy * cosA, sy * (rotatedCenterY - sinA * oldCenterX - cosA * oldCenterY)}};
+    return warpAffine(matrix, newWidth, newHeight);
 }
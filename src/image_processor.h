@@ -1,48 +1,121 @@
 #ifndef IMAGE_PROCESSOR_H
 #define IMAGE_PROCESSOR_H
 
+#include <functional>
 #include <string>
+#include <vector>
 #include "buddy_allocator.h"
+#include "resample.h"
+#include "thread_pool.h"
 
 class ImageProcessor {
 public:
+    // How rotateImage resamples angles that are not multiples of 90 degrees
+    enum class RotationMode {
+        Bilinear, // 2x2 neighbourhood per destination pixel (rotateBilinear)
+        Shear     // Three 1-D shears of whole rows (rotateShear)
+    };
+
     ImageProcessor(bool useBuddySystem, BuddyAllocator* allocator);
     ~ImageProcessor();
 
-    // Load an image from file
+    // Load an image from file, or from standard input when filename is "-"
     bool loadImage(const std::string& filename);
 
-    // Save the image to file
-    bool saveImage(const std::string& filename);
+    // Load an image from its encoded bytes (any format loadImage accepts)
+    bool loadImageFromMemory(const unsigned char* bytes, size_t size);
+
+    // Save the image to file, or to standard output when filename is "-".
+    // format ("jpg", "jpeg", "png" or "bmp") overrides the file extension and
+    // is required for standard output.
+    bool saveImage(const std::string& filename, const std::string& format = "");
+
+    // Encode the image as format ("jpg", "jpeg", "png" or "bmp") into encoded,
+    // which is replaced
+    bool encodeImage(const std::string& format, std::vector<unsigned char>& encoded);
 
-    // Rotate the image by the specified angle (in degrees)
-    void rotateImage(double angle);
+    // Rotate the image by the specified angle (in degrees). Multiples of 90
+    // degrees are copied exactly instead of resampled.
+    bool rotateImage(double angle);
 
     // Scale the image by the specified factor
-    void scaleImage(double factor);
+    bool scaleImage(double factor);
+
+    // Resample the image through a 2x3 affine matrix mapping source pixel
+    // coordinates to output ones, into a newWidth x newHeight image
+    bool warpAffine(const AffineMatrix& matrix, int newWidth, int newHeight);
+
+    // rotateImage followed by scaleImage (same output size and geometry),
+    // resampled once through the composed transform
+    bool rotateAndScale(double angle, double factor);
+
+    // Choose the bilinear arithmetic used by rotate and scale (fixed point by default)
+    void setInterpolation(Interpolation mode);
+
+    // Choose how rotations are resampled (bilinear by default). In shear
+    // mode rotateAndScale rotates and then scales instead of fusing them.
+    void setRotationMode(RotationMode mode);
+
+    // Spread rotate, scale and warp over the threads of pool (not owned);
+    // nullptr, the default, runs them on the calling thread. The output is
+    // the same either way.
+    void setThreadPool(ThreadPool* pool);
 
     // Get image information
     void getImageInfo(int& width, int& height, int& channels);
 
+    // Free the image, leaving the processor empty as after construction
+    void clear();
+
+    // Whether saveImage and encodeImage write format ("jpg", "jpeg", "png"
+    // or "bmp", in any case)
+    static bool isSupportedFormat(const std::string& format);
+
 private:
+    // Rows of the buffers rotate, scale and warp produce start on cache-line
+    // boundaries so vector loads never straddle one. Loaded images keep the
+    // decoder's tightly packed rows, which are adopted without a copy.
+    static const size_t rowAlignment = 64;
+
+    // Largest side of an image rotate, scale and warp produce, which keeps
+    // sizes and offsets far from overflowing
+    static const int maxDimension = 1 << 20;
+
     // Image data
     unsigned char* imageData;
     int width;
     int height;
     int channels;
 
+    // Bytes between the starts of consecutive rows
+    size_t stride;
+
     // Memory allocation mode
     bool useBuddySystem;
     BuddyAllocator* allocator;
 
+    // Sampling arithmetic for rotate and scale
+    Interpolation interpolation;
+    RotationMode rotationMode;
+
+    // Threads resampling is split over, or nullptr
+    ThreadPool* threadPool;
+
+    // Receives the output of writeImage in chunks (stbi_write_func)
+    typedef void WriteCallback(void* context, void* data, int size);
+
     // Helper methods
-    void allocateImage(int w, int h, int c);
+    bool adoptDecoded(unsigned char* decoded, int w, int h, int c, const std::string& source);
+    bool writeImage(const std::string& format, WriteCallback* write, void* context);
     void deallocateImage();
-
-    // Nuevas versiones con tamaño de buffer
-    unsigned char* getPixel(unsigned char* data, int x, int y, int c, int w, int h);
-    void setPixel(unsigned char* data, int x, int y, int c, unsigned char value, int w, int h);
-    unsigned char bilinearInterpolation(unsigned char* data, double x, double y, int c, int w, int h);
+    unsigned char* allocateBuffer(size_t size);
+    void freeBuffer(unsigned char* buffer);
+    static size_t rowPitch(int w, int c);
+    static int quarterTurns(double angle);
+    bool rotateQuarterTurns(int turns);
+    static void rotatedSize(double angle, int w, int h, int& rotatedWidth, int& rotatedHeight);
+    static bool scaledSize(int w, int h, double factor, int& scaledWidth, int& scaledHeight);
+    bool runKernel(unsigned char* buffer, const std::function<void()>& kernel);
 };
 
 #endif // IMAGE_PROCESSOR_H
\ No newline at end of file
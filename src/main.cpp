@@ -1,12 +1,21 @@
 #include <iostream>
 #include <chrono>
+#include <filesystem>
+#include <fstream>
 #include <string>
 #include <vector>
+#include <atomic>
 #include <cmath>
+#include <csignal>
+#include <cstdio>
 #include <cstring>
+#include <algorithm>
 #include <malloc.h>
+#include "batch.h"
 #include "buddy_allocator.h"
 #include "image_processor.h"
+#include "server.h"
+#include "thread_pool.h"
 
 #define VERSION "1.0.0"
 
@@ -14,22 +23,59 @@
 struct ProgramOptions {
     std::string inputFile;
     std::string outputFile;
+    std::string outputFormat;
     double rotationAngle = 0.0;
     double scaleFactor = 1.0;
+    bool rotationGiven = false;
+    bool scaleGiven = false;
+    bool twoPass = false;
+    bool shear = false;
     bool useBuddySystem = false;
+    bool compare = false;
+    bool batch = false;
+    int workers = 1;
+    bool pipeline = false;
+    int pipelineDepth = 4;
+    std::string serveSocket;
+    int threads = 1;
+    size_t poolMB = 16;
+    size_t poolMaxMB = 4096;
+    long poolIdleMs = 1000;
+    BuddyAllocator::PageMode pageMode = BuddyAllocator::PageMode::Normal;
+    std::string statsFile;
     bool showHelp = false;
     bool showVersion = false;
 };
 
 void printUsage() {
     std::cout << "=== AYUDA: USO DEL PROGRAMA ===" << std::endl;
-    std::cout << "Uso:\n  ./program_image entrada.jpg salida.jpg -angulo ANGULO -escalar ESCALA [-buddy]\n" << std::endl;
+    std::cout << "Uso:\n  ./program_image entrada.jpg salida.jpg -angulo ANGULO -escalar ESCALA [-buddy] [-compare] [-threads N] [-pool-mb MB] [-pool-max-mb MB]" << std::endl;
+    std::cout << "  ./program_image -batch DIRECTORIO DIR_SALIDA -angulo ANGULO -escalar ESCALA [-workers N] [-threads N] [-buddy]" << std::endl;
+    std::cout << "  ./program_image -batch MANIFIESTO [-workers N] [-threads N] [-buddy]" << std::endl;
+    std::cout << "  ./program_image -serve SOCKET [-workers N] [-threads N] [-buddy]\n" << std::endl;
     std::cout << "Parámetros:" << std::endl;
-    std::cout << "  entrada.jpg        Archivo de imagen de entrada" << std::endl;
-    std::cout << "  salida.jpg         Archivo donde se guarda la imagen procesada" << std::endl;
+    std::cout << "  entrada.jpg        Archivo de imagen de entrada ('-' = entrada estándar)" << std::endl;
+    std::cout << "  salida.jpg         Archivo donde se guarda la imagen procesada ('-' = salida estándar, requiere -format)" << std::endl;
+    std::cout << "  -format FORMATO    (Opcional) Formato de salida: jpg, png o bmp (por defecto, la extensión de salida)" << std::endl;
     std::cout << "  -angulo ANGULO     Ángulo de rotación (en grados, puede ser decimal)" << std::endl;
     std::cout << "  -escalar ESCALA    Factor de escalado (por ejemplo 0.5, 1.5, 2.0, etc.)" << std::endl;
+    std::cout << "  -two-pass          (Opcional) Rota y luego escala en dos remuestreos en lugar de una sola transformación afín" << std::endl;
+    std::cout << "  -shear             (Opcional) Rota con tres cizallas 1-D (Paeth) en lugar de interpolación bilineal" << std::endl;
     std::cout << "  -buddy             (Opcional) Usa el sistema de asignación de memoria Buddy System" << std::endl;
+    std::cout << "  -batch             Procesa todas las imágenes de DIRECTORIO (con el mismo ángulo y escala) o las líneas" << std::endl;
+    std::cout << "                     'entrada salida ángulo escala' de MANIFIESTO" << std::endl;
+    std::cout << "  -workers N         (Opcional) Hilos del modo -batch, cada uno con su procesador y su arena Buddy (por defecto 1; 0 = todos los núcleos)" << std::endl;
+    std::cout << "  -pipeline          (Opcional) Procesa el lote en tres etapas concurrentes (decodificar, transformar, codificar)" << std::endl;
+    std::cout << "  -pipeline-depth N  (Opcional) Imágenes en vuelo en el modo -pipeline (por defecto 4)" << std::endl;
+    std::cout << "  -serve SOCKET      Atiende trabajos en un socket Unix hasta recibir SIGINT o SIGTERM; cada worker" << std::endl;
+    std::cout << "                     mantiene su procesador, su arena Buddy y sus hilos entre peticiones" << std::endl;
+    std::cout << "  -compare           (Opcional) Procesa con new/delete y con Buddy System y compara tiempo y memoria" << std::endl;
+    std::cout << "  -threads N         (Opcional) Hilos para rotar y escalar (por defecto 1; 0 = todos los núcleos)" << std::endl;
+    std::cout << "  -pool-mb MB        (Opcional) Tamaño inicial del pool Buddy en MB (por defecto 16)" << std::endl;
+    std::cout << "  -pool-max-mb MB    (Opcional) Límite de crecimiento del pool Buddy en MB (por defecto 4096)" << std::endl;
+    std::cout << "  -pool-idle-ms MS   (Opcional) Tiempo vacío antes de liberar arenas adicionales (por defecto 1000)" << std::endl;
+    std::cout << "  -huge-pages MODO   (Opcional) Páginas grandes para el pool Buddy: thp o hugetlb" << std::endl;
+    std::cout << "  -stats-json ARCH   (Opcional) Guarda las estadísticas del pool Buddy en JSON ('-' = salida estándar)" << std::endl;
     std::cout << "  -h, --help         Muestra esta ayuda" << std::endl;
     std::cout << "  -v, --version      Muestra la versión del programa" << std::endl;
 }
@@ -61,10 +107,57 @@ ProgramOptions parseCommandLine(int argc, char* argv[]) {
             exit(0);
         } else if (arg == "-angulo" && i + 1 < argc) {
             options.rotationAngle = std::stod(argv[++i]);
+            options.rotationGiven = true;
         } else if (arg == "-escalar" && i + 1 < argc) {
             options.scaleFactor = std::stod(argv[++i]);
+            options.scaleGiven = true;
+        } else if (arg == "-format" && i + 1 < argc) {
+            options.outputFormat = argv[++i];
+        } else if (arg == "-two-pass") {
+            options.twoPass = true;
+        } else if (arg == "-shear") {
+            options.shear = true;
         } else if (arg == "-buddy") {
             options.useBuddySystem = true;
+        } else if (arg == "-compare") {
+            options.compare = true;
+        } else if (arg == "-batch") {
+            options.batch = true;
+        } else if (arg == "-pipeline") {
+            options.pipeline = true;
+        } else if (arg == "-pipeline-depth" && i + 1 < argc) {
+            options.pipelineDepth = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "-serve" && i + 1 < argc) {
+            options.serveSocket = argv[++i];
+        } else if (arg == "-workers" && i + 1 < argc) {
+            options.workers = std::stoi(argv[++i]);
+            if (options.workers <= 0) {
+                options.workers = std::max(1u, std::thread::hardware_concurrency());
+            }
+        } else if (arg == "-threads" && i + 1 < argc) {
+            options.threads = std::stoi(argv[++i]);
+            if (options.threads <= 0) {
+                options.threads = std::max(1u, std::thread::hardware_concurrency());
+            }
+        } else if (arg == "-pool-mb" && i + 1 < argc) {
+            options.poolMB = std::stoul(argv[++i]);
+        } else if (arg == "-pool-max-mb" && i + 1 < argc) {
+            options.poolMaxMB = std::stoul(argv[++i]);
+        } else if (arg == "-pool-idle-ms" && i + 1 < argc) {
+            options.poolIdleMs = std::stol(argv[++i]);
+        } else if (arg == "-stats-json" && i + 1 < argc) {
+            options.statsFile = argv[++i];
+        } else if (arg == "-huge-pages" && i + 1 < argc) {
+            std::string mode = argv[++i];
+            if (mode == "thp") {
+                options.pageMode = BuddyAllocator::PageMode::TransparentHuge;
+            } else if (mode == "hugetlb") {
+                options.pageMode = BuddyAllocator::PageMode::ExplicitHuge;
+            } else {
+                std::cout << "Modo de páginas desconocido: " << mode << std::endl;
+                printUsage();
+                exit(1);
+            }
         } else if (options.inputFile.empty()) {
             options.inputFile = arg;
         } else if (options.outputFile.empty()) {
@@ -76,7 +169,12 @@ ProgramOptions parseCommandLine(int argc, char* argv[]) {
         }
     }
 
-    if (options.inputFile.empty() || options.outputFile.empty()) {
+    if (options.batch && options.inputFile.empty()) {
+        std::cout << "Falta el directorio o manifiesto de -batch." << std::endl;
+        printUsage();
+        exit(1);
+    }
+    if (!options.batch && options.serveSocket.empty() && (options.inputFile.empty() || options.outputFile.empty())) {
         std::cout << "Faltan archivos de entrada/salida." << std::endl;
         printUsage();
         exit(1);
@@ -85,45 +183,129 @@ ProgramOptions parseCommandLine(int argc, char* argv[]) {
     return options;
 }
 
-int main(int argc, char* argv[]) {
-    ProgramOptions options = parseCommandLine(argc, argv);
+// Smallest order whose block holds the requested number of megabytes
+size_t poolOrderForMB(size_t megabytes) {
+    size_t order = 20;
+    while ((size_t(1) << order) < megabytes * 1024 * 1024) {
+        order++;
+    }
+    return order;
+}
 
-    std::cout << "=== PROCESAMIENTO DE IMAGEN ===" << std::endl;
-    std::cout << "Archivo de entrada: " << options.inputFile << std::endl;
-    std::cout << "Archivo de salida: " << options.outputFile << std::endl;
-    std::cout << "Modo de asignación de memoria: " << (options.useBuddySystem ? "Buddy System" : "Convencional") << std::endl;
+// Rotate and scale the image; with both requested they are fused into a
+// single affine resampling unless -two-pass is given
+bool transformImage(ImageProcessor& processor, const ProgramOptions& options) {
+    bool fused = options.rotationGiven && options.scaleGiven && !options.twoPass;
+    return transformJob(processor, options.rotationAngle, options.scaleFactor, !fused);
+}
+
+// Apply the options that do not depend on the allocation mode
+void configureProcessor(ImageProcessor& processor, const ProgramOptions& options, ThreadPool& threadPool) {
+    processor.setThreadPool(&threadPool);
+    if (options.shear) {
+        processor.setRotationMode(ImageProcessor::RotationMode::Shear);
+    }
+}
+
+void printImageInfo(ImageProcessor& processor, const ProgramOptions& options) {
+    int width, height, channels;
+    processor.getImageInfo(width, height, channels);
+    std::cout << "Dimensiones originales: " << width << " x " << height << std::endl;
+    std::cout << "Canales: " << channels << (channels == 3 ? " (RGB)" : " (RGBA)") << std::endl;
+    std::cout << "Ángulo de rotación: " << options.rotationAngle << " grados" << std::endl;
+    std::cout << "Factor de escalado: " << options.scaleFactor << std::endl;
     std::cout << "------------------------" << std::endl;
+}
+
+bool writeStats(const BuddyAllocator::Stats& stats, const std::string& statsFile) {
+    if (statsFile == "-") {
+        std::cout << stats.toJson() << std::endl;
+    } else if (!statsFile.empty()) {
+        std::ofstream statsOut(statsFile);
+        statsOut << stats.toJson() << std::endl;
+        if (!statsOut) {
+            std::cerr << "Error escribiendo estadísticas en " << statsFile << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Production path: decode, transform and encode once with the chosen allocator
+int runSingle(const ProgramOptions& options, BuddyAllocator& buddyAllocator, ThreadPool& threadPool) {
+    auto start = std::chrono::high_resolution_clock::now();
+    ImageProcessor processor(options.useBuddySystem, options.useBuddySystem ? &buddyAllocator : nullptr);
+    configureProcessor(processor, options, threadPool);
+
+    if (!processor.loadImage(options.inputFile)) {
+        std::cerr << "Error cargando la imagen: " << options.inputFile << std::endl;
+        return 1;
+    }
+    printImageInfo(processor, options);
 
-    // Inicializar el Buddy Allocator
-    BuddyAllocator buddyAllocator(24); // 16MB
+    if (!transformImage(processor, options)) {
+        std::cerr << "Error procesando la imagen"
+                  << (options.useBuddySystem ? " con Buddy System (aumente -pool-max-mb)" : "") << std::endl;
+        return 1;
+    }
+    if (!processor.saveImage(options.outputFile, options.outputFormat)) {
+        std::cerr << "Error guardando la imagen: " << options.outputFile << std::endl;
+        return 1;
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+
+    int finalWidth, finalHeight, finalChannels;
+    processor.getImageInfo(finalWidth, finalHeight, finalChannels);
+
+    std::cout << "Dimensiones finales: " << finalWidth << " x " << finalHeight << std::endl;
+    std::cout << "Tiempo de procesamiento: " << duration.count() << " ms" << std::endl;
+    if (options.useBuddySystem) {
+        BuddyAllocator::Stats buddyStats = buddyAllocator.stats();
+        std::cout << "Memoria Buddy: " << buddyStats.allocatedBytes / (1024.0 * 1024.0) << " MB"
+                  << " (pico " << buddyStats.peakAllocatedBytes / (1024.0 * 1024.0) << " MB)" << std::endl;
+    }
+    std::cout << "[INFO] Imagen guardada correctamente en " << options.outputFile << std::endl;
+
+    if (options.useBuddySystem) {
+        return writeStats(buddyAllocator.stats(), options.statsFile) ? 0 : 1;
+    }
+    return 0;
+}
+
+// Benchmark path: the same job with new/delete and with the Buddy System,
+// side by side. The conventional result is encoded to a temporary file
+// (removed afterwards) so both timings include the encode.
+int runComparison(const ProgramOptions& options, BuddyAllocator& buddyAllocator, ThreadPool& threadPool) {
+    const std::string conventionalOutput = "temp_conventional.jpg";
 
     // Proceso convencional
     auto startConventional = std::chrono::high_resolution_clock::now();
     ImageProcessor conventionalProcessor(false, nullptr);
+    configureProcessor(conventionalProcessor, options, threadPool);
 
     if (!conventionalProcessor.loadImage(options.inputFile)) {
         std::cerr << "Error cargando la imagen: " << options.inputFile << std::endl;
         return 1;
     }
+    printImageInfo(conventionalProcessor, options);
 
-    int origWidth, origHeight, origChannels;
-    conventionalProcessor.getImageInfo(origWidth, origHeight, origChannels);
-    std::cout << "Dimensiones originales: " << origWidth << " x " << origHeight << std::endl;
-    std::cout << "Canales: " << origChannels << (origChannels == 3 ? " (RGB)" : " (RGBA)") << std::endl;
-    std::cout << "Ángulo de rotación: " << options.rotationAngle << " grados" << std::endl;
-    std::cout << "Factor de escalado: " << options.scaleFactor << std::endl;
-    std::cout << "------------------------" << std::endl;
-
-    conventionalProcessor.rotateImage(options.rotationAngle);
-    std::cout << "[INFO] Imagen rotada correctamente." << std::endl;
-
-    conventionalProcessor.scaleImage(options.scaleFactor);
-    std::cout << "[INFO] Imagen escalada correctamente." << std::endl;
+    if (!transformImage(conventionalProcessor, options)) {
+        std::cerr << "Error procesando la imagen sin Buddy System" << std::endl;
+        return 1;
+    }
+    std::cout << "[INFO] Imagen rotada y escalada correctamente." << std::endl;
 
-    conventionalProcessor.saveImage("temp_conventional.jpg");
+    if (!conventionalProcessor.saveImage(conventionalOutput, options.outputFormat)) {
+        std::cerr << "Error guardando la imagen: " << conventionalOutput << std::endl;
+        std::remove(conventionalOutput.c_str());
+        return 1;
+    }
 
     auto endConventional = std::chrono::high_resolution_clock::now();
     auto durationConventional = std::chrono::duration_cast<std::chrono::milliseconds>(endConventional - startConventional);
+    std::remove(conventionalOutput.c_str());
 
     struct mallinfo2 mallocInfo = mallinfo2();
     size_t conventionalMemory = mallocInfo.uordblks;
@@ -131,15 +313,19 @@ int main(int argc, char* argv[]) {
     // Proceso con Buddy System
     auto startBuddy = std::chrono::high_resolution_clock::now();
     ImageProcessor buddyProcessor(true, &buddyAllocator);
+    configureProcessor(buddyProcessor, options, threadPool);
 
-    buddyProcessor.loadImage(options.inputFile);
-    buddyProcessor.rotateImage(options.rotationAngle);
-    buddyProcessor.scaleImage(options.scaleFactor);
-    buddyProcessor.saveImage(options.outputFile);
+    if (!buddyProcessor.loadImage(options.inputFile) ||
+        !transformImage(buddyProcessor, options) ||
+        !buddyProcessor.saveImage(options.outputFile, options.outputFormat)) {
+        std::cerr << "Error procesando la imagen con Buddy System (aumente -pool-max-mb)" << std::endl;
+        return 1;
+    }
 
     auto endBuddy = std::chrono::high_resolution_clock::now();
     auto durationBuddy = std::chrono::duration_cast<std::chrono::milliseconds>(endBuddy - startBuddy);
-    size_t buddyMemory = buddyAllocator.getTotalAllocated();
+    BuddyAllocator::Stats buddyStats = buddyAllocator.stats();
+    size_t buddyMemory = buddyStats.allocatedBytes;
 
     int finalWidth, finalHeight, finalChannels;
     buddyProcessor.getImageInfo(finalWidth, finalHeight, finalChannels);
@@ -153,9 +339,176 @@ int main(int argc, char* argv[]) {
     std::cout << std::endl;
     std::cout << "MEMORIA UTILIZADA:" << std::endl;
     std::cout << " - Sin Buddy System: " << conventionalMemory / (1024.0 * 1024.0) << " MB" << std::endl;
-    std::cout << " - Con Buddy System: " << buddyMemory / (1024.0 * 1024.0) << " MB" << std::endl;
+    std::cout << " - Con Buddy System: " << buddyMemory / (1024.0 * 1024.0) << " MB"
+              << " (pico " << buddyStats.peakAllocatedBytes / (1024.0 * 1024.0) << " MB)" << std::endl;
     std::cout << "------------------------" << std::endl;
     std::cout << "[INFO] Imagen guardada correctamente en " << options.outputFile << std::endl;
 
+    return writeStats(buddyStats, options.statsFile) ? 0 : 1;
+}
+
+// Worker, allocator and transform settings shared by batch and server modes
+BatchSettings batchSettings(const ProgramOptions& options) {
+    BatchSettings settings;
+    settings.workers = options.workers;
+    settings.useBuddySystem = options.useBuddySystem;
+    settings.poolOrder = poolOrderForMB(options.poolMB);
+    settings.poolLimitBytes = std::max(options.poolMaxMB, options.poolMB) * 1024 * 1024;
+    settings.poolIdleMs = options.poolIdleMs;
+    settings.pageMode = options.pageMode;
+    settings.twoPass = options.twoPass;
+    settings.shear = options.shear;
+    settings.pipelineDepth = options.pipelineDepth;
+    settings.transformThreads = options.threads;
+    return settings;
+}
+
+// Batch path: every image of a directory or manifest, spread over workers
+// that each keep one ImageProcessor and allocator arena for all their images
+int runBatchMode(const ProgramOptions& options) {
+    std::vector<BatchJob> jobs;
+    std::error_code error;
+    if (std::filesystem::is_directory(options.inputFile, error)) {
+        if (options.outputFile.empty()) {
+            std::cerr << "-batch con un directorio necesita un directorio de salida" << std::endl;
+            return 1;
+        }
+        if (!listDirectory(options.inputFile, options.outputFile, options.rotationAngle, options.scaleFactor, jobs)) {
+            return 1;
+        }
+    } else if (!readManifest(options.inputFile, jobs)) {
+        return 1;
+    }
+
+    BatchSettings settings = batchSettings(options);
+
+    std::cout << "=== PROCESAMIENTO POR LOTES ===" << std::endl;
+    std::cout << "Origen: " << options.inputFile << " (" << jobs.size() << " imágenes)" << std::endl;
+    std::cout << "Modo de asignación de memoria: " << (options.useBuddySystem ? "Buddy System" : "Convencional") << std::endl;
+    if (options.pipeline) {
+        std::cout << "Pipeline: " << options.pipelineDepth << " imágenes en vuelo, " << options.threads
+                  << " hilos de transformación" << std::endl;
+    } else {
+        std::cout << "Workers: " << options.workers << ", " << options.threads << " hilos de transformación cada uno" << std::endl;
+    }
+    std::cout << "------------------------" << std::endl;
+
+    size_t finished = 0;
+    auto reportJob = [&](size_t index, const BatchResult& result) {
+        const BatchJob& job = jobs[index];
+        std::cout << "[" << ++finished << "/" << jobs.size() << "] " << job.inputFile;
+        if (!result.ok) {
+            std::cout << ": ERROR" << std::endl;
+            return;
+        }
+        double megapixels = result.inputWidth * static_cast<double>(result.inputHeight) / 1e6;
+        std::cout << " -> " << job.outputFile << ": " << result.inputWidth << "x" << result.inputHeight
+                  << " -> " << result.outputWidth << "x" << result.outputHeight << ", "
+                  << result.milliseconds << " ms, " << megapixels / (result.milliseconds / 1000.0) << " MP/s" << std::endl;
+    };
+
+    std::vector<StageUsage> stages;
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<BatchResult> results = options.pipeline ? runPipeline(jobs, settings, reportJob, stages)
+                                                        : runBatch(jobs, settings, reportJob);
+    auto end = std::chrono::high_resolution_clock::now();
+    double wallSeconds = std::chrono::duration<double>(end - start).count();
+
+    size_t succeeded = 0;
+    double megapixels = 0, busyMs = 0;
+    for (const BatchResult& result : results) {
+        busyMs += result.milliseconds;
+        if (!result.ok) continue;
+        succeeded++;
+        megapixels += result.inputWidth * static_cast<double>(result.inputHeight) / 1e6;
+    }
+
+    std::cout << "------------------------" << std::endl;
+    std::cout << "Imágenes procesadas: " << succeeded << "/" << jobs.size() << std::endl;
+    std::cout << "Tiempo total: " << wallSeconds * 1000 << " ms (suma por imagen " << busyMs << " ms)" << std::endl;
+    std::cout << "Rendimiento: " << succeeded / wallSeconds << " imágenes/s, " << megapixels / wallSeconds << " MP/s" << std::endl;
+    for (const StageUsage& stage : stages) {
+        std::cout << "Etapa " << stage.name << ": ocupada " << stage.busyMilliseconds << " ms ("
+                  << 100.0 * stage.busyMilliseconds / stage.wallMilliseconds << "%)" << std::endl;
+    }
+    return succeeded == jobs.size() ? 0 : 1;
+}
+
+// Set by SIGINT and SIGTERM to stop the server
+std::atomic<bool> stopServer(false);
+
+void requestServerStop(int) {
+    stopServer.store(true);
+}
+
+// Server path: jobs arrive over a Unix socket and are served by warm workers
+int runServerMode(const ProgramOptions& options) {
+    std::signal(SIGINT, requestServerStop);
+    std::signal(SIGTERM, requestServerStop);
+
+    std::cout << "=== SERVIDOR DE TRABAJOS ===" << std::endl;
+    std::cout << "Socket: " << options.serveSocket << std::endl;
+    std::cout << "Modo de asignación de memoria: " << (options.useBuddySystem ? "Buddy System" : "Convencional") << std::endl;
+    std::cout << "Workers: " << options.workers << ", hilos por trabajo: " << options.threads << std::endl;
+    std::cout << "------------------------" << std::endl;
+
+    if (!runServer(options.serveSocket, batchSettings(options), stopServer)) {
+        return 1;
+    }
+    std::cout << "Servidor detenido" << std::endl;
     return 0;
 }
+
+int main(int argc, char* argv[]) {
+    ProgramOptions options = parseCommandLine(argc, argv);
+    if (!options.serveSocket.empty()) {
+        return runServerMode(options);
+    }
+    if (options.batch) {
+        return runBatchMode(options);
+    }
+
+    // The image goes to standard output, so the report goes to standard error
+    if (options.outputFile == "-") {
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
+
+    std::cout << "=== PROCESAMIENTO DE IMAGEN ===" << std::endl;
+    std::cout << "Archivo de entrada: " << options.inputFile << std::endl;
+    std::cout << "Archivo de salida: " << options.outputFile << std::endl;
+    if (options.compare) {
+        std::cout << "Modo: comparación (Convencional y Buddy System)" << std::endl;
+    } else {
+        std::cout << "Modo de asignación de memoria: " << (options.useBuddySystem ? "Buddy System" : "Convencional") << std::endl;
+    }
+    std::cout << "Hilos: " << options.threads << std::endl;
+    std::cout << "------------------------" << std::endl;
+
+    if (!options.statsFile.empty() && !options.useBuddySystem && !options.compare) {
+        std::cerr << "-stats-json requiere -buddy o -compare" << std::endl;
+        return 1;
+    }
+    if (options.compare && options.inputFile == "-") {
+        std::cerr << "-compare lee la entrada dos veces y no admite la entrada estándar" << std::endl;
+        return 1;
+    }
+    if (options.statsFile == "-" && options.outputFile == "-") {
+        std::cerr << "-stats-json - y la salida '-' no pueden compartir la salida estándar" << std::endl;
+        return 1;
+    }
+
+    // Inicializar el Buddy Allocator; crece con arenas adicionales hasta el
+    // límite. La memoria de las arenas se reserva de forma perezosa, así que
+    // no cuesta nada en modo convencional.
+    BuddyAllocator buddyAllocator(poolOrderForMB(options.poolMB), false, options.pageMode);
+    buddyAllocator.setPoolLimit(std::max(options.poolMaxMB, options.poolMB) * 1024 * 1024);
+    buddyAllocator.setIdleRelease(std::chrono::milliseconds(options.poolIdleMs));
+
+    // Los hilos se crean una vez y se reutilizan en cada operación
+    ThreadPool threadPool(options.threads);
+
+    if (options.compare) {
+        return runComparison(options, buddyAllocator, threadPool);
+    }
+    return runSingle(options, buddyAllocator, threadPool);
+}
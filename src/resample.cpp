@@ -0,0 +1,1069 @@
+#include "resample.h"
+#include "thread_pool.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+#include <memory>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define RESAMPLE_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+
+// Fixed-point bilinear weights are integers in [0, weightOne) and blended
+// values keep blendBits fractional bits between the horizontal and vertical
+// steps; every intermediate fits in 16 bits, so SIMD kernels can blend all
+// channels of several pixels in 16-bit lanes with the same results
+const int weightBits = 15;
+const int weightOne = 1 << weightBits;
+const int blendBits = 7;
+
+// a * weight / weightOne rounded to nearest (pmulhrsw)
+inline int mulRound(int a, int weight) {
+    return (a * weight + (1 << (weightBits - 1))) >> weightBits;
+}
+
+inline int fixedWeight(double frac) {
+    int weight = static_cast<int>(frac * weightOne + 0.5);
+    return weight < weightOne ? weight : weightOne - 1;
+}
+
+// Samplers and kernels are templated on the channel count C (1-4), so the
+// per-channel loops unroll into fixed-size loads and stores; the image's
+// channel count is dispatched once per call (see withChannels)
+
+template <int C>
+inline const unsigned char* pixelAt(const ImageView& image, int x, int y) {
+    if (x < 0) x = 0;
+    if (x >= image.width) x = image.width - 1;
+    if (y < 0) y = 0;
+    if (y >= image.height) y = image.height - 1;
+
+    return image.data + y * image.stride + x * C;
+}
+
+// The original kernel: double weights recomputed per channel, truncated
+template <int C>
+inline void sampleDouble(const ImageView& src, double x, double y, unsigned char* out) {
+    int x1 = static_cast<int>(x);
+    int y1 = static_cast<int>(y);
+
+    double xFrac = x - x1;
+    double yFrac = y - y1;
+
+    const unsigned char* p1 = pixelAt<C>(src, x1, y1);
+    const unsigned char* p2 = pixelAt<C>(src, x1 + 1, y1);
+    const unsigned char* p3 = pixelAt<C>(src, x1, y1 + 1);
+    const unsigned char* p4 = pixelAt<C>(src, x1 + 1, y1 + 1);
+
+    for (int c = 0; c < C; c++) {
+        double top = p1[c] * (1 - xFrac) + p2[c] * xFrac;
+        double bottom = p3[c] * (1 - xFrac) + p4[c] * xFrac;
+        out[c] = static_cast<unsigned char>(top * (1 - yFrac) + bottom * yFrac);
+    }
+}
+
+// Warps address the source in 32.32 fixed point. Positions along a row are
+// start + k * step exactly, so a row can be walked incrementally (DDA) or
+// entered at any column with the same result, and the columns that land
+// inside the source follow from integer division.
+const int coordBits = 32;
+const double coordOne = 4294967296.0;
+const int64_t coordFraction = (int64_t(1) << coordBits) - 1;
+
+// Larger steps leave any image in one pixel; clamping them keeps a step past
+// the last sampled column from overflowing
+const int64_t maxStep = int64_t(1) << 61;
+
+inline int64_t toCoord(double value) {
+    return static_cast<int64_t>(std::floor(value * coordOne + 0.5));
+}
+
+inline int64_t toStep(double value) {
+    double scaled = value * coordOne;
+    if (scaled > maxStep) return maxStep;
+    if (scaled < -maxStep) return -maxStep;
+    return static_cast<int64_t>(std::floor(scaled + 0.5));
+}
+
+// Integer weights computed once per pixel, rounded to nearest. Callers keep
+// (x, y) inside the image, so only the right and lower neighbours can fall
+// off an edge.
+template <int C>
+inline void sampleFixed(const ImageView& src, int64_t x, int64_t y, unsigned char* out) {
+    int x1 = static_cast<int>(x >> coordBits);
+    int y1 = static_cast<int>(y >> coordBits);
+
+    // fixedWeight of the fractional part, rounded on its top weightBits bits
+    const int64_t half = int64_t(1) << (coordBits - weightBits - 1);
+    int fx = static_cast<int>(std::min<int64_t>(((x & coordFraction) + half) >> (coordBits - weightBits), weightOne - 1));
+    int fy = static_cast<int>(std::min<int64_t>(((y & coordFraction) + half) >> (coordBits - weightBits), weightOne - 1));
+
+    const unsigned char* p1 = src.data + y1 * src.stride + x1 * C;
+    const unsigned char* p3 = y1 + 1 < src.height ? p1 + src.stride : p1;
+    int right = x1 + 1 < src.width ? C : 0;
+
+    for (int c = 0; c < C; c++) {
+        int top = (p1[c] << blendBits) + mulRound((p1[c + right] - p1[c]) * (1 << blendBits), fx);
+        int bottom = (p3[c] << blendBits) + mulRound((p3[c + right] - p3[c]) * (1 << blendBits), fx);
+        int value = top + mulRound(bottom - top, fy);
+        out[c] = static_cast<unsigned char>((value + (1 << (blendBits - 1))) >> blendBits);
+    }
+}
+
+// Interpolation policies: how a warp blends the sample at a fixed-point
+// source position
+struct FixedPointBlend {
+    template <int C>
+    static void sample(const ImageView& src, int64_t x, int64_t y, unsigned char* out) {
+        sampleFixed<C>(src, x, y, out);
+    }
+};
+
+struct DoubleBlend {
+    template <int C>
+    static void sample(const ImageView& src, int64_t x, int64_t y, unsigned char* out) {
+        sampleDouble<C>(src, x / coordOne, y / coordOne, out);
+    }
+};
+
+// Call function with the channel count as a std::integral_constant
+template <class Function>
+void withChannels(int channels, Function function) {
+    switch (channels) {
+    case 1: function(std::integral_constant<int, 1>()); break;
+    case 2: function(std::integral_constant<int, 2>()); break;
+    case 3: function(std::integral_constant<int, 3>()); break;
+    default: function(std::integral_constant<int, 4>()); break;
+    }
+}
+
+// Call kernel with the channel count and the interpolation's blend policy
+template <class Kernel>
+void dispatch(int channels, Interpolation interpolation, Kernel kernel) {
+    if (interpolation == Interpolation::FixedPoint) {
+        withChannels(channels, [&](auto c) { kernel(c, FixedPointBlend()); });
+    } else {
+        withChannels(channels, [&](auto c) { kernel(c, DoubleBlend()); });
+    }
+}
+
+// Call rows(begin, end) on bands of bandRows rows covering [0, height),
+// spread over the threads of pool; without one, once for all rows. A row is
+// computed the same way whichever band it falls in, so the output does not
+// depend on the thread count.
+template <class Rows>
+void forEachBand(ThreadPool* pool, int height, int bandRows, Rows rows) {
+    if (!pool || pool->size() == 1) {
+        rows(0, height);
+        return;
+    }
+    int bands = (height + bandRows - 1) / bandRows;
+    pool->parallelFor(bands, [&](int band) {
+        int begin = band * bandRows;
+        rows(begin, std::min(height, begin + bandRows));
+    });
+}
+
+// Source positions a warp samples, in fixed point: 0 <= x <= maxX and
+// 0 <= y <= maxY
+struct SourceBounds {
+    int64_t maxX;
+    int64_t maxY;
+};
+
+// Destination columns [begin, end) of one row, with the source position of
+// begin and the per-column step
+struct RowSpan {
+    int begin;
+    int end;
+    int64_t x;
+    int64_t y;
+    int64_t stepX;
+    int64_t stepY;
+};
+
+// Floor of a / b for b > 0
+inline int64_t floorDiv(int64_t a, int64_t b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+// Narrow the offsets first..last to those k with low <= start + k * step <= high
+void clipAxis(int64_t start, int64_t step, int64_t low, int64_t high, int64_t& first, int64_t& last) {
+    if (step == 0) {
+        if (start < low || start > high) last = first - 1;
+        return;
+    }
+    int64_t kMin, kMax;
+    if (step > 0) {
+        kMin = -floorDiv(start - low, step);
+        kMax = floorDiv(high - start, step);
+    } else {
+        kMin = -floorDiv(high - start, -step);
+        kMax = floorDiv(start - low, -step);
+    }
+    first = std::max(first, kMin);
+    last = std::min(last, kMax);
+}
+
+// The part of span whose positions satisfy 0 <= x <= maxX and 0 <= y <= maxY
+RowSpan clipSpan(const RowSpan& span, int64_t maxX, int64_t maxY) {
+    int64_t first = 0;
+    int64_t last = span.end - span.begin - 1;
+    clipAxis(span.x, span.stepX, 0, maxX, first, last);
+    clipAxis(span.y, span.stepY, 0, maxY, first, last);
+    if (first > last) {
+        return {span.begin, span.begin, span.x, span.y, span.stepX, span.stepY};
+    }
+    return {span.begin + static_cast<int>(first), span.begin + static_cast<int>(last) + 1,
+            span.x + first * span.stepX, span.y + first * span.stepY, span.stepX, span.stepY};
+}
+
+// Narrow [first, last] to the columns where low <= start + slope * x <= high,
+// widened by a source pixel on each side so rounding never loses a column
+void estimateAxis(double start, double slope, double low, double high, double& first, double& last) {
+    if (slope == 0) {
+        if (start < low - 1 || start > high + 1) last = first - 1;
+        return;
+    }
+    double from = (low - 1 - start) / slope;
+    double to = (high + 1 - start) / slope;
+    if (slope < 0) std::swap(from, to);
+    first = std::max(first, from);
+    last = std::min(last, to);
+}
+
+// Columns of row y of a width-wide destination whose source position lies
+// inside bounds. A double-precision estimate picks the column the fixed-point
+// walk starts from, and the exact span is clipped from there.
+RowSpan rowSpan(const AffineMatrix& inverse, const SourceBounds& bounds, int width, int y) {
+    const double* m = inverse.m;
+    RowSpan span = {0, 0, 0, 0, toStep(m[0]), toStep(m[3])};
+    double rowX = m[1] * y + m[2];
+    double rowY = m[4] * y + m[5];
+
+    double first = 0;
+    double last = width - 1;
+    estimateAxis(rowX, m[0], 0, bounds.maxX / coordOne, first, last);
+    estimateAxis(rowY, m[3], 0, bounds.maxY / coordOne, first, last);
+    if (!(first <= last)) return span;
+
+    span.begin = static_cast<int>(std::ceil(first));
+    span.end = static_cast<int>(std::floor(last)) + 1;
+    if (span.begin >= span.end) return {0, 0, 0, 0, span.stepX, span.stepY};
+    span.x = toCoord(m[0] * span.begin + rowX);
+    span.y = toCoord(m[3] * span.begin + rowY);
+    return clipSpan(span, bounds.maxX, bounds.maxY);
+}
+
+// Spans of the destination rows [rowBegin, rowEnd), indexed from rowBegin
+std::vector<RowSpan> rowSpans(const AffineMatrix& inverse, const SourceBounds& bounds, const ImageView& dst,
+                              int rowBegin, int rowEnd) {
+    std::vector<RowSpan> spans(rowEnd - rowBegin);
+    for (int y = rowBegin; y < rowEnd; y++) {
+        spans[y - rowBegin] = rowSpan(inverse, bounds, dst.width, y);
+    }
+    return spans;
+}
+
+// Columns [from, to) of span, with the source position moved to the new
+// begin; an empty result starts and ends at from
+inline RowSpan subSpan(const RowSpan& span, int from, int to) {
+    int begin = std::max(span.begin, from);
+    int end = std::min(span.end, to);
+    if (begin >= end) {
+        return {from, from, span.x, span.y, span.stepX, span.stepY};
+    }
+    return {begin, end, span.x + (begin - span.begin) * span.stepX, span.y + (begin - span.begin) * span.stepY,
+            span.stepX, span.stepY};
+}
+
+// Background for the columns of [from, to) outside span
+inline void clearOutside(unsigned char* row, const RowSpan& span, int from, int to, int channels) {
+    std::memset(row + static_cast<size_t>(from) * channels, 0, static_cast<size_t>(span.begin - from) * channels);
+    std::memset(row + static_cast<size_t>(span.end) * channels, 0, static_cast<size_t>(to - span.end) * channels);
+}
+
+bool tilingEnabled = true;
+
+size_t l2CacheSize() {
+    static const size_t size = [] {
+        long bytes = sysconf(_SC_LEVEL2_CACHE_SIZE);
+        return bytes > 0 ? static_cast<size_t>(bytes) : static_cast<size_t>(256 * 1024);
+    }();
+    return size;
+}
+
+// Destination rows per tile and the most distinct source pages a tile may
+// touch, well inside a second-level TLB
+const int tileRows = 64;
+const double tilePages = 1024;
+
+// Width of the destination tiles a warp walks: the largest power of two
+// (whole rows if that is wider) for which the source a tileRows-high tile
+// reads fits in half the L2 and in tilePages pages. A tile maps to a
+// parallelogram in the source; its cache lines are its area plus the two
+// partial lines at either end of each source row it crosses, and its pages
+// about one per row crossed plus its area. Near 0 degrees that allows whole
+// rows, which keeps hardware prefetch streams long; near 90 tiles narrow so
+// consecutive destination rows still find the source columns cached.
+int warpTileWidth(const AffineMatrix& inverse, int width, int channels) {
+    const double* m = inverse.m;
+    double area = std::abs(m[0] * m[4] - m[1] * m[3]) * channels;
+    double lineBudget = l2CacheSize() / 2.0 / 64;
+
+    int tile = 64;
+    while (tile < width) {
+        int next = tile * 2;
+        double rowsCrossed = next * std::abs(m[3]) + tileRows * std::abs(m[4]) + 2;
+        double lines = next * tileRows * area / 64 + 2 * rowsCrossed;
+        double pages = next * tileRows * area / 4096 + rowsCrossed;
+        if (lines > lineBudget || pages > tilePages) break;
+        tile = next;
+    }
+    return tile < width ? tile : width;
+}
+
+// Call segment(y, from, to) for every row segment of the destination rows
+// [rowBegin, rowEnd), tile by tile so the source a rotation reads stays
+// cached and its pages stay in the TLB however steep the angle; with tiling
+// disabled, whole rows in order. Bands start on multiples of tileRows, so
+// tiles line up however the rows are split between threads.
+template <class Segment>
+void forEachTile(const ImageView& dst, const AffineMatrix& inverse, int rowBegin, int rowEnd, Segment segment) {
+    int tileWidth = dst.width;
+    int tileHeight = 1;
+    if (tilingEnabled) {
+        tileWidth = warpTileWidth(inverse, dst.width, dst.channels);
+        tileHeight = tileRows;
+    }
+
+    for (int tileY = rowBegin; tileY < rowEnd; tileY += tileHeight) {
+        int tileBottom = std::min(rowEnd, tileY + tileHeight);
+        for (int tileX = 0; tileX < dst.width; tileX += tileWidth) {
+            int tileRight = std::min(dst.width, tileX + tileWidth);
+            for (int y = tileY; y < tileBottom; y++) {
+                segment(y, tileX, tileRight);
+            }
+        }
+    }
+}
+
+// Sample the columns of span, stepping the source position per column
+template <int C, class Blend>
+inline void walkSpan(const ImageView& src, const RowSpan& span, unsigned char* row) {
+    int64_t x = span.x;
+    int64_t y = span.y;
+    for (int i = span.begin; i < span.end; i++) {
+        Blend::template sample<C>(src, x, y, row + i * C);
+        x += span.stepX;
+        y += span.stepY;
+    }
+}
+
+// Square tiles the quarter-turn copy walks so that the source column it
+// reads stays in L1 while the destination rows are written
+const int quarterTurnTile = 64;
+
+// Copy one tile of a quarter turn. Along a destination row the source pixel
+// moves by sourceStep bytes (one source row up or down).
+template <int C>
+void copyQuarterTile(const ImageView& src, const ImageView& dst, int quarterTurns,
+                     int tileX, int tileY, int tileWidth, int tileHeight) {
+    ptrdiff_t sourceStep = quarterTurns == 1 ? -static_cast<ptrdiff_t>(src.stride)
+                                             : static_cast<ptrdiff_t>(src.stride);
+    for (int y = tileY; y < tileY + tileHeight; y++) {
+        // 90 degrees: dst(x, y) = src(y, h - 1 - x); 270: dst(x, y) = src(w - 1 - y, x)
+        const unsigned char* in = quarterTurns == 1
+            ? src.data + (src.height - 1 - tileX) * src.stride + y * C
+            : src.data + tileX * src.stride + (src.width - 1 - y) * C;
+        unsigned char* out = dst.data + y * dst.stride + tileX * C;
+        int x = 0;
+        // Three-byte pixels move as four-byte words: the extra byte written
+        // is overwritten by the next pixel, and the extra byte read is inside
+        // the source row unless it is the last column
+        int sourceColumn = quarterTurns == 1 ? y : src.width - 1 - y;
+        if (C == 3 && sourceColumn < src.width - 1) {
+            for (; x < tileWidth - 1; x++) {
+                uint32_t pixel;
+                std::memcpy(&pixel, in, sizeof(pixel));
+                std::memcpy(out, &pixel, sizeof(pixel));
+                out += C;
+                in += sourceStep;
+            }
+        }
+        for (; x < tileWidth; x++) {
+            std::memcpy(out, in, C);
+            out += C;
+            in += sourceStep;
+        }
+    }
+}
+
+// Tiles of the destination rows [rowBegin, rowEnd); rowBegin is a multiple
+// of quarterTurnTile
+template <int C>
+void rotateQuarterBlocked(const ImageView& src, const ImageView& dst, int quarterTurns, int rowBegin, int rowEnd) {
+    for (int tileY = rowBegin; tileY < rowEnd; tileY += quarterTurnTile) {
+        int tileHeight = std::min(quarterTurnTile, rowEnd - tileY);
+        for (int tileX = 0; tileX < dst.width; tileX += quarterTurnTile) {
+            int tileWidth = std::min(quarterTurnTile, dst.width - tileX);
+            copyQuarterTile<C>(src, dst, quarterTurns, tileX, tileY, tileWidth, tileHeight);
+        }
+    }
+}
+
+// Tiles of the destination rows [rowBegin, rowEnd) of dst(x, y) = src(y, x)
+template <int C>
+void transposeBlocked(const ImageView& src, const ImageView& dst, int rowBegin, int rowEnd) {
+    for (int tileY = rowBegin; tileY < rowEnd; tileY += quarterTurnTile) {
+        int tileBottom = std::min(rowEnd, tileY + quarterTurnTile);
+        for (int tileX = 0; tileX < dst.width; tileX += quarterTurnTile) {
+            int tileRight = std::min(dst.width, tileX + quarterTurnTile);
+            for (int y = tileY; y < tileBottom; y++) {
+                const unsigned char* in = src.data + tileX * src.stride + y * C;
+                unsigned char* out = dst.data + y * dst.stride + tileX * C;
+                for (int x = tileX; x < tileRight; x++) {
+                    std::memcpy(out, in, C);
+                    out += C;
+                    in += src.stride;
+                }
+            }
+        }
+    }
+}
+
+// Swap every pixel of the rows [rowBegin, rowEnd) of the top half with its
+// mirror through the centre
+template <int C>
+void rotateHalfTurnPixels(const ImageView& image, int rowBegin, int rowEnd) {
+    for (int y = rowBegin; y < rowEnd; y++) {
+        unsigned char* top = image.data + y * image.stride;
+        unsigned char* bottom = image.data + (image.height - 1 - y) * image.stride + (image.width - 1) * C;
+        // The middle row of an odd-height image mirrors onto itself
+        int count = top + (image.width - 1) * C == bottom ? image.width / 2 : image.width;
+        for (int x = 0; x < count; x++) {
+            unsigned char pixel[C];
+            std::memcpy(pixel, top, C);
+            std::memcpy(top, bottom, C);
+            std::memcpy(bottom, pixel, C);
+            top += C;
+            bottom -= C;
+        }
+    }
+}
+
+// Source position feeding one destination column of a resize
+struct ColumnTap {
+    int offset; // Byte offset of the left neighbour within a row
+    int right;  // Bytes to the right neighbour (0 on the last column)
+    int weight; // Fixed-point weight of the right neighbour
+};
+
+// Horizontal pass of the separable scaler: blend one source row into
+// blendBits fixed-point intermediates, exactly as sampleFixed does
+template <int C>
+void filterRow(const unsigned char* row, const std::vector<ColumnTap>& taps, int16_t* out) {
+    for (const ColumnTap& tap : taps) {
+        const unsigned char* left = row + tap.offset;
+        for (int c = 0; c < C; c++) {
+            *out++ = static_cast<int16_t>((left[c] << blendBits) +
+                                          mulRound((left[c + tap.right] - left[c]) * (1 << blendBits), tap.weight));
+        }
+    }
+}
+
+// Vertical pass: blend two filtered rows with weight fy and round to bytes
+void blendRows(const int16_t* top, const int16_t* bottom, int fy, unsigned char* out, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        int value = top[i] + mulRound(bottom[i] - top[i], fy);
+        out[i] = static_cast<unsigned char>((value + (1 << (blendBits - 1))) >> blendBits);
+    }
+}
+
+// Shear pass: out[i] = a[i] + (b[i] - a[i]) * weight / weightOne, rounded
+void blendShifted(const unsigned char* a, const unsigned char* b, int weight, unsigned char* out, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] = static_cast<unsigned char>(a[i] + mulRound(b[i] - a[i], weight));
+    }
+}
+
+bool simdEnabled = true;
+
+#ifdef RESAMPLE_X86
+
+bool cpuHasAvx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+
+// Blend four pixels' 2x2 neighbourhoods, every channel widened to a 16-bit
+// lane, with per-lane weights; same arithmetic as sampleFixed
+__attribute__((target("avx2")))
+inline __m256i blendAvx2(__m256i p1, __m256i p2, __m256i p3, __m256i p4, __m256i fx, __m256i fy) {
+    __m256i top = _mm256_add_epi16(_mm256_slli_epi16(p1, blendBits),
+                                   _mm256_mulhrs_epi16(_mm256_slli_epi16(_mm256_sub_epi16(p2, p1), blendBits), fx));
+    __m256i bottom = _mm256_add_epi16(_mm256_slli_epi16(p3, blendBits),
+                                      _mm256_mulhrs_epi16(_mm256_slli_epi16(_mm256_sub_epi16(p4, p3), blendBits), fx));
+    __m256i value = _mm256_add_epi16(top, _mm256_mulhrs_epi16(_mm256_sub_epi16(bottom, top), fy));
+    return _mm256_srli_epi16(_mm256_add_epi16(value, _mm256_set1_epi16(1 << (blendBits - 1))), blendBits);
+}
+
+// Blend eight pixels whose neighbours are packed one pixel per 32-bit lane.
+// Widening bytes to 16 bits splits each 128-bit half into pixels {0, 1} and
+// {2, 3}; the weights are spread the same way and packing restores the order.
+__attribute__((target("avx2")))
+inline __m256i blendPixelsAvx2(__m256i g1, __m256i g2, __m256i g3, __m256i g4, __m256i fx, __m256i fy) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i fxPair = _mm256_or_si256(fx, _mm256_slli_epi32(fx, 16));
+    __m256i fyPair = _mm256_or_si256(fy, _mm256_slli_epi32(fy, 16));
+
+    __m256i low = blendAvx2(_mm256_unpacklo_epi8(g1, zero), _mm256_unpacklo_epi8(g2, zero),
+                            _mm256_unpacklo_epi8(g3, zero), _mm256_unpacklo_epi8(g4, zero),
+                            _mm256_unpacklo_epi32(fxPair, fxPair), _mm256_unpacklo_epi32(fyPair, fyPair));
+    __m256i high = blendAvx2(_mm256_unpackhi_epi8(g1, zero), _mm256_unpackhi_epi8(g2, zero),
+                             _mm256_unpackhi_epi8(g3, zero), _mm256_unpackhi_epi8(g4, zero),
+                             _mm256_unpackhi_epi32(fxPair, fxPair), _mm256_unpackhi_epi32(fyPair, fyPair));
+    return _mm256_packus_epi16(low, high);
+}
+
+// Write eight pixels held one per 32-bit lane (channels in the low bytes)
+template <int C>
+__attribute__((target("avx2")))
+inline void storePixelsAvx2(unsigned char* out, __m256i pixels) {
+    if (C == 4) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), pixels);
+        return;
+    }
+
+    // Drop the unused bytes of each lane, leaving 4 * C bytes per 128-bit half
+    const __m256i compact = C == 3
+        ? _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                           0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1)
+        : C == 2
+        ? _mm256_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1,
+                           0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1)
+        : _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                           0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    alignas(32) unsigned char packed[32];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(packed), _mm256_shuffle_epi8(pixels, compact));
+    std::memcpy(out, packed, 4 * C);
+    std::memcpy(out + 4 * C, packed + 16, 4 * C);
+}
+
+__attribute__((target("avx2")))
+inline __m256i combineHalves(__m128i low, __m128i high) {
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+}
+
+// Fixed-point warp of one row segment, eight destination pixels per step.
+// part is the segment's span and inner the columns of it whose 2x2
+// neighbourhood lies strictly inside the source: there groups of eight are
+// gathered (one 32-bit load per neighbour covers every channel) and blended
+// in integer lanes from the same fixed-point positions as the scalar walk,
+// which handles the columns near the edges. The upper register halves are
+// cleared before calling scalar code, which the compiler does not do for
+// target-attribute functions.
+template <int C>
+__attribute__((target("avx2")))
+void warpSegmentAvx2(const ImageView& src, unsigned char* row, const RowSpan& part, const RowSpan& inner) {
+    if (inner.begin >= inner.end) {
+        walkSpan<C, FixedPointBlend>(src, part, row);
+        return;
+    }
+    walkSpan<C, FixedPointBlend>(src, {part.begin, inner.begin, part.x, part.y, part.stepX, part.stepY}, row);
+
+    const __m256i fractionV = _mm256_set1_epi64x(coordFraction);
+    const __m256i halfV = _mm256_set1_epi64x(int64_t(1) << (coordBits - weightBits - 1));
+    const __m256i weightMax = _mm256_set1_epi32(weightOne - 1);
+    const __m256i strideV = _mm256_set1_epi32(static_cast<int>(src.stride));
+    const __m256i channelsV = _mm256_set1_epi32(C);
+    const int* base = reinterpret_cast<const int*>(src.data);
+
+    // Positions of the even pixels of a group sit in the first register and
+    // the odd ones in the second, so that blending their 32-bit halves
+    // together yields the eight pixels in order
+    const __m256i evenX = _mm256_setr_epi64x(0, 2 * part.stepX, 4 * part.stepX, 6 * part.stepX);
+    const __m256i evenY = _mm256_setr_epi64x(0, 2 * part.stepY, 4 * part.stepY, 6 * part.stepY);
+    const __m256i oddX = _mm256_add_epi64(evenX, _mm256_set1_epi64x(part.stepX));
+    const __m256i oddY = _mm256_add_epi64(evenY, _mm256_set1_epi64x(part.stepY));
+
+    int64_t groupX = inner.x;
+    int64_t groupY = inner.y;
+    int x = inner.begin;
+    for (; x + 8 <= inner.end; x += 8) {
+        __m256i xEven = _mm256_add_epi64(_mm256_set1_epi64x(groupX), evenX);
+        __m256i xOdd = _mm256_add_epi64(_mm256_set1_epi64x(groupX), oddX);
+        __m256i yEven = _mm256_add_epi64(_mm256_set1_epi64x(groupY), evenY);
+        __m256i yOdd = _mm256_add_epi64(_mm256_set1_epi64x(groupY), oddY);
+        groupX += 8 * part.stepX;
+        groupY += 8 * part.stepY;
+
+        __m256i x1 = _mm256_blend_epi32(_mm256_srli_epi64(xEven, coordBits), xOdd, 0xAA);
+        __m256i y1 = _mm256_blend_epi32(_mm256_srli_epi64(yEven, coordBits), yOdd, 0xAA);
+
+        const int weightShift = coordBits - weightBits;
+        __m256i fxEven = _mm256_srli_epi64(_mm256_add_epi64(_mm256_and_si256(xEven, fractionV), halfV), weightShift);
+        __m256i fxOdd = _mm256_srli_epi64(_mm256_add_epi64(_mm256_and_si256(xOdd, fractionV), halfV), weightShift);
+        __m256i fyEven = _mm256_srli_epi64(_mm256_add_epi64(_mm256_and_si256(yEven, fractionV), halfV), weightShift);
+        __m256i fyOdd = _mm256_srli_epi64(_mm256_add_epi64(_mm256_and_si256(yOdd, fractionV), halfV), weightShift);
+        __m256i fxV = _mm256_min_epi32(_mm256_blend_epi32(fxEven, _mm256_slli_epi64(fxOdd, 32), 0xAA), weightMax);
+        __m256i fyV = _mm256_min_epi32(_mm256_blend_epi32(fyEven, _mm256_slli_epi64(fyOdd, 32), 0xAA), weightMax);
+
+        __m256i offsets = _mm256_add_epi32(_mm256_mullo_epi32(y1, strideV), _mm256_mullo_epi32(x1, channelsV));
+        __m256i g1 = _mm256_i32gather_epi32(base, offsets, 1);
+        __m256i g3 = _mm256_i32gather_epi32(base, _mm256_add_epi32(offsets, strideV), 1);
+        __m256i g2, g4;
+        if (C <= 2) {
+            // One load already holds both horizontal neighbours
+            g2 = _mm256_srli_epi32(g1, 8 * C);
+            g4 = _mm256_srli_epi32(g3, 8 * C);
+        } else {
+            g2 = _mm256_i32gather_epi32(base, _mm256_add_epi32(offsets, channelsV), 1);
+            g4 = _mm256_i32gather_epi32(base, _mm256_add_epi32(offsets, _mm256_add_epi32(strideV, channelsV)), 1);
+        }
+
+        storePixelsAvx2<C>(row + x * C, blendPixelsAvx2(g1, g2, g3, g4, fxV, fyV));
+    }
+
+    _mm256_zeroupper();
+    walkSpan<C, FixedPointBlend>(src, {x, part.end, groupX, groupY, part.stepX, part.stepY}, row);
+}
+
+template <int C>
+void warpFixedAvx2(const ImageView& src, const ImageView& dst, const AffineMatrix& inverse, const SourceBounds& bounds,
+                   int rowBegin, int rowEnd) {
+    // Interior: the right and lower neighbours exist without clamping. With
+    // fewer than 4 channels a 32-bit gather reads past the pixel, so keep a
+    // spare row below to stay inside the buffer.
+    const int64_t innerX = (static_cast<int64_t>(src.width - 1) << coordBits) - 1;
+    const int64_t innerY = (static_cast<int64_t>(C == 4 ? src.height - 1 : src.height - 2) << coordBits) - 1;
+
+    std::vector<RowSpan> spans = rowSpans(inverse, bounds, dst, rowBegin, rowEnd);
+    std::vector<RowSpan> inners(spans.size());
+    for (size_t i = 0; i < spans.size(); i++) {
+        inners[i] = clipSpan(spans[i], innerX, innerY);
+    }
+
+    forEachTile(dst, inverse, rowBegin, rowEnd, [&](int y, int from, int to) {
+        unsigned char* row = dst.data + y * dst.stride;
+        RowSpan part = subSpan(spans[y - rowBegin], from, to);
+        clearOutside(row, part, from, to, C);
+        warpSegmentAvx2<C>(src, row, part, subSpan(inners[y - rowBegin], part.begin, part.end));
+    });
+}
+
+// blendRows on 32 values per step
+__attribute__((target("avx2")))
+void blendRowsAvx2(const int16_t* top, const int16_t* bottom, int fy, unsigned char* out, size_t count) {
+    const __m256i weight = _mm256_set1_epi16(static_cast<short>(fy));
+    const __m256i round = _mm256_set1_epi16(1 << (blendBits - 1));
+
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i packed[2];
+        for (int half = 0; half < 2; half++) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(top + i + 16 * half));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bottom + i + 16 * half));
+            __m256i value = _mm256_add_epi16(a, _mm256_mulhrs_epi16(_mm256_sub_epi16(b, a), weight));
+            packed[half] = _mm256_srli_epi16(_mm256_add_epi16(value, round), blendBits);
+        }
+        // packus interleaves the 128-bit halves of its operands; restore the order
+        __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(packed[0], packed[1]), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), bytes);
+    }
+    _mm256_zeroupper();
+    blendRows(top + i, bottom + i, fy, out + i, count - i);
+}
+
+// blendShifted on 32 bytes per step
+__attribute__((target("avx2")))
+void blendShiftedAvx2(const unsigned char* a, const unsigned char* b, int weight, unsigned char* out, size_t count) {
+    const __m256i weightV = _mm256_set1_epi16(static_cast<short>(weight));
+
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i packed[2];
+        for (int half = 0; half < 2; half++) {
+            __m256i left = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 16 * half)));
+            __m256i right = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + 16 * half)));
+            packed[half] = _mm256_add_epi16(left, _mm256_mulhrs_epi16(_mm256_sub_epi16(right, left), weightV));
+        }
+        __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(packed[0], packed[1]), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), bytes);
+    }
+    _mm256_zeroupper();
+    blendShifted(a + i, b + i, weight, out + i, count - i);
+}
+
+// The gathers address the source with 32-bit byte offsets
+bool useAvx2(const ImageView& src) {
+    return simdEnabled && cpuHasAvx2() && src.channels >= 1 && src.channels <= 4 &&
+           src.height >= 2 && src.stride * src.height <= static_cast<size_t>(INT_MAX);
+}
+
+#endif // RESAMPLE_X86
+
+// Portable warp: only the span of each row that lands inside bounds is
+// sampled, the rest is cleared to the background
+template <int C, class Blend>
+void warpScalar(const ImageView& src, const ImageView& dst, const AffineMatrix& inverse, const SourceBounds& bounds,
+                int rowBegin, int rowEnd) {
+    std::vector<RowSpan> spans = rowSpans(inverse, bounds, dst, rowBegin, rowEnd);
+    forEachTile(dst, inverse, rowBegin, rowEnd, [&](int y, int from, int to) {
+        unsigned char* row = dst.data + y * dst.stride;
+        RowSpan part = subSpan(spans[y - rowBegin], from, to);
+        clearOutside(row, part, from, to, C);
+        walkSpan<C, Blend>(src, part, row);
+    });
+}
+
+// Resample src into dst; inverse maps destination pixels to source positions
+void warpInverse(const ImageView& src, const ImageView& dst, const AffineMatrix& inverse,
+                 const SourceBounds& bounds, Interpolation interpolation, ThreadPool* pool) {
+#ifdef RESAMPLE_X86
+    if (interpolation == Interpolation::FixedPoint && useAvx2(src)) {
+        withChannels(src.channels, [&](auto c) {
+            forEachBand(pool, dst.height, tileRows, [&](int rowBegin, int rowEnd) {
+                warpFixedAvx2<decltype(c)::value>(src, dst, inverse, bounds, rowBegin, rowEnd);
+            });
+        });
+        return;
+    }
+#endif
+
+    dispatch(src.channels, interpolation, [&](auto c, auto blend) {
+        forEachBand(pool, dst.height, tileRows, [&](int rowBegin, int rowEnd) {
+            warpScalar<decltype(c)::value, decltype(blend)>(src, dst, inverse, bounds, rowBegin, rowEnd);
+        });
+    });
+}
+
+// Destination rows per band a resize hands to each thread
+const int scaleBandRows = 64;
+
+// Separable fixed-point resize. Column taps are computed once per image; each
+// source row is filtered horizontally once into a two-row cache that
+// consecutive output rows share, then pairs of cached rows are blended
+// vertically. Output is identical to sampling every pixel with sampleFixed.
+// Each band of rows keeps its own cache, refiltering at most the two source
+// rows it shares with the band above.
+template <int C>
+void scaleFixed(const ImageView& src, const ImageView& dst, double xRatio, double yRatio, ThreadPool* pool) {
+    std::vector<ColumnTap> taps(dst.width);
+    for (int x = 0; x < dst.width; x++) {
+        double xOld = x * xRatio;
+        int x1 = static_cast<int>(xOld);
+        taps[x] = {x1 * C, x1 + 1 < src.width ? C : 0, fixedWeight(xOld - x1)};
+    }
+
+    size_t rowLength = static_cast<size_t>(dst.width) * C;
+#ifdef RESAMPLE_X86
+    bool vectorBlend = simdEnabled && cpuHasAvx2();
+#endif
+
+    forEachBand(pool, dst.height, scaleBandRows, [&](int rowBegin, int rowEnd) {
+        std::vector<int16_t> cache(2 * rowLength);
+        int16_t* cachedRows[2] = {cache.data(), cache.data() + rowLength};
+        int cachedSource[2] = {-1, -1};
+
+        // Filtered source row, computed into the slot not holding row keep
+        auto filtered = [&](int sourceRow, int keep) -> const int16_t* {
+            for (int slot = 0; slot < 2; slot++) {
+                if (cachedSource[slot] == sourceRow) return cachedRows[slot];
+            }
+            int slot = cachedSource[0] == keep ? 1 : 0;
+            filterRow<C>(src.data + sourceRow * src.stride, taps, cachedRows[slot]);
+            cachedSource[slot] = sourceRow;
+            return cachedRows[slot];
+        };
+
+        for (int y = rowBegin; y < rowEnd; y++) {
+            double yOld = y * yRatio;
+            int y1 = static_cast<int>(yOld);
+            int y2 = y1 + 1 < src.height ? y1 + 1 : y1;
+            int fy = fixedWeight(yOld - y1);
+
+            const int16_t* top = filtered(y1, y2);
+            const int16_t* bottom = filtered(y2, y1);
+            unsigned char* row = dst.data + y * dst.stride;
+#ifdef RESAMPLE_X86
+            if (vectorBlend) {
+                blendRowsAvx2(top, bottom, fy, row, rowLength);
+                continue;
+            }
+#endif
+            blendRows(top, bottom, fy, row, rowLength);
+        }
+    });
+}
+
+// Per-pixel resize with the original double-precision kernel
+template <int C>
+void scaleDouble(const ImageView& src, const ImageView& dst, double xRatio, double yRatio, ThreadPool* pool) {
+    forEachBand(pool, dst.height, scaleBandRows, [&](int rowBegin, int rowEnd) {
+        for (int y = rowBegin; y < rowEnd; y++) {
+            unsigned char* row = dst.data + y * dst.stride;
+            for (int x = 0; x < dst.width; x++) {
+                sampleDouble<C>(src, x * xRatio, y * yRatio, row + x * C);
+            }
+        }
+    });
+}
+
+// Rows per band a shear pass or transpose hands to each thread
+const int shearBandRows = 64;
+
+// Source pixel x of row in, or the background outside [0, width)
+inline const unsigned char* shearSource(const unsigned char* in, int64_t x, int width, int channels,
+                                        const unsigned char* background) {
+    return x >= 0 && x < width ? in + x * channels : background;
+}
+
+// Row y of a shear pass: out (width pixels) is src row y sampled at column
+// x + shiftBase + shiftPerRow * y, blending the two nearest pixels with the
+// row's single fixed-point weight. The whole row moves by one amount, so the
+// source is read sequentially and the blend runs over contiguous bytes
+// whatever the channel count. Columns that fall off src blend with the
+// background, as do rows below it.
+void shearRow(const ImageView& src, int y, unsigned char* out, int width, double shiftBase, double shiftPerRow) {
+    const int C = src.channels;
+    double shift = shiftBase + shiftPerRow * y;
+    if (y >= src.height || !(std::abs(shift) < static_cast<double>(INT_MAX))) {
+        std::memset(out, 0, static_cast<size_t>(width) * C);
+        return;
+    }
+    double whole = std::floor(shift);
+    int64_t k = static_cast<int64_t>(whole);
+    int weight = fixedWeight(shift - whole);
+    const unsigned char* in = src.data + y * src.stride;
+
+    // Columns x read pixels x + k and x + k + 1: both inside src on
+    // [innerBegin, innerEnd), one of them up to touchBegin and touchEnd,
+    // none beyond
+    auto clampColumn = [width](int64_t x) {
+        return static_cast<int>(std::min<int64_t>(std::max<int64_t>(x, 0), width));
+    };
+    int touchBegin = clampColumn(-k - 1);
+    int innerBegin = clampColumn(-k);
+    int innerEnd = std::max(innerBegin, clampColumn(src.width - 1 - k));
+    int touchEnd = std::max(innerEnd, clampColumn(src.width - k));
+
+    std::memset(out, 0, static_cast<size_t>(touchBegin) * C);
+    std::memset(out + static_cast<size_t>(touchEnd) * C, 0, static_cast<size_t>(width - touchEnd) * C);
+    const unsigned char background[4] = {0, 0, 0, 0};
+    auto edge = [&](int x) {
+        blendShifted(shearSource(in, x + k, src.width, C, background),
+                     shearSource(in, x + k + 1, src.width, C, background), weight, out + x * C, C);
+    };
+    for (int x = touchBegin; x < innerBegin; x++) edge(x);
+    for (int x = innerEnd; x < touchEnd; x++) edge(x);
+
+    const unsigned char* left = in + (innerBegin + k) * C;
+    size_t count = static_cast<size_t>(innerEnd - innerBegin) * C;
+#ifdef RESAMPLE_X86
+    if (simdEnabled && cpuHasAvx2()) {
+        blendShiftedAvx2(left, left + C, weight, out + innerBegin * C, count);
+        return;
+    }
+#endif
+    blendShifted(left, left + C, weight, out + innerBegin * C, count);
+}
+
+// Shear every row of src into dst, which has src's height
+void shearRows(const ImageView& src, const ImageView& dst, double shiftBase, double shiftPerRow, ThreadPool* pool) {
+    forEachBand(pool, dst.height, shearBandRows, [&](int rowBegin, int rowEnd) {
+        for (int y = rowBegin; y < rowEnd; y++) {
+            shearRow(src, y, dst.data + y * dst.stride, dst.width, shiftBase, shiftPerRow);
+        }
+    });
+}
+
+// Shear the rows of src into rows dst.height pixels wide and store them
+// transposed: dst(x, y) = sheared(y, x), so dst is src.height wide. Bands
+// of shearBandRows rows are sheared into a scratch block that stays in the
+// L2 and copied out in tiles from there, instead of transposing a whole
+// sheared image in a second pass.
+void shearTransposed(const ImageView& src, const ImageView& dst, double shiftBase, double shiftPerRow,
+                     ThreadPool* pool) {
+    const size_t C = src.channels;
+    const size_t blockStride = dst.height * C;
+    forEachBand(pool, src.height, shearBandRows, [&](int rowBegin, int rowEnd) {
+        std::unique_ptr<unsigned char[]> block(new unsigned char[shearBandRows * blockStride]);
+        for (int bandBegin = rowBegin; bandBegin < rowEnd; bandBegin += shearBandRows) {
+            int bandEnd = std::min(rowEnd, bandBegin + shearBandRows);
+            for (int y = bandBegin; y < bandEnd; y++) {
+                shearRow(src, y, block.get() + (y - bandBegin) * blockStride, dst.height, shiftBase, shiftPerRow);
+            }
+            ImageView sheared = {block.get(), dst.height, bandEnd - bandBegin, src.channels, blockStride};
+            ImageView columns = {dst.data + bandBegin * C, bandEnd - bandBegin, dst.height, dst.channels, dst.stride};
+            withChannels(src.channels, [&](auto c) {
+                transposeBlocked<decltype(c)::value>(sheared, columns, 0, columns.height);
+            });
+        }
+    });
+}
+
+} // namespace
+
+void rotateQuarterTurns(const ImageView& src, const ImageView& dst, int quarterTurns, ThreadPool* pool) {
+    withChannels(src.channels, [&](auto c) {
+        forEachBand(pool, dst.height, quarterTurnTile, [&](int rowBegin, int rowEnd) {
+            rotateQuarterBlocked<decltype(c)::value>(src, dst, quarterTurns, rowBegin, rowEnd);
+        });
+    });
+}
+
+void rotateHalfTurn(const ImageView& image, ThreadPool* pool) {
+    withChannels(image.channels, [&](auto c) {
+        forEachBand(pool, (image.height + 1) / 2, quarterTurnTile, [&](int rowBegin, int rowEnd) {
+            rotateHalfTurnPixels<decltype(c)::value>(image, rowBegin, rowEnd);
+        });
+    });
+}
+
+void setSimdEnabled(bool enabled) {
+    simdEnabled = enabled;
+}
+
+void setTilingEnabled(bool enabled) {
+    tilingEnabled = enabled;
+}
+
+AffineMatrix invertAffine(const AffineMatrix& matrix) {
+    const double* m = matrix.m;
+    double determinant = m[0] * m[4] - m[1] * m[3];
+    double a = m[4] / determinant;
+    double b = -m[1] / determinant;
+    double d = -m[3] / determinant;
+    double e = m[0] / determinant;
+    return {{a, b, -(a * m[2] + b * m[5]), d, e, -(d * m[2] + e * m[5])}};
+}
+
+void warpBilinear(const ImageView& src, const ImageView& dst, const AffineMatrix& matrix, Interpolation interpolation,
+                  ThreadPool* pool) {
+    // Positions up to the far edge of the last row and column are sampled
+    // with clamping, as scaleBilinear does
+    SourceBounds bounds = {(static_cast<int64_t>(src.width) << coordBits) - 1,
+                           (static_cast<int64_t>(src.height) << coordBits) - 1};
+    warpInverse(src, dst, invertAffine(matrix), bounds, interpolation, pool);
+}
+
+void rotateBilinear(const ImageView& src, const ImageView& dst, double angle, Interpolation interpolation,
+                    ThreadPool* pool) {
+    double radians = angle * PI / 180.0;
+    double cosA = std::cos(radians);
+    double sinA = std::sin(radians);
+
+    // Destination offsets from dst's centre, rotated back about src's centre
+    double oldCenterX = src.width / 2.0;
+    double oldCenterY = src.height / 2.0;
+    double newCenterX = dst.width / 2.0;
+    double newCenterY = dst.height / 2.0;
+    AffineMatrix inverse = {{cosA, sinA, oldCenterX - cosA * newCenterX - sinA * newCenterY,
+                             -sinA, cosA, oldCenterY + sinA * newCenterX - cosA * newCenterY}};
+    SourceBounds bounds = {static_cast<int64_t>(src.width - 1) << coordBits,
+                           static_cast<int64_t>(src.height - 1) << coordBits};
+    warpInverse(src, dst, inverse, bounds, interpolation, pool);
+}
+
+void rotateShear(const ImageView& src, const ImageView& dst, double angle, ThreadPool* pool) {
+    // angle = 90 * turns + residual with |residual| <= 45: the quarter turns
+    // are exact, so the shears stay below tan(22.5) and sin(45)
+    double turnsNearest = std::round(angle / 90.0);
+    double residual = angle - 90.0 * turnsNearest;
+    int turns = static_cast<int>(std::fmod(turnsNearest, 4.0));
+    if (turns < 0) turns += 4;
+
+    // The source as a plane image: point p is at pixel p + origin, where
+    // p is the offset from the centre rotateBilinear rotates about, already
+    // turned by the quarter turns. The exact quarter turns map pixels about
+    // ((w - 1) / 2, (h - 1) / 2) rather than (w / 2, h / 2), hence the -1s.
+    size_t channels = src.channels;
+    ImageView plane = src;
+    double originX = src.width / 2.0;
+    double originY = src.height / 2.0;
+    std::unique_ptr<unsigned char[]> turned;
+    if (turns != 0) {
+        int turnedWidth = turns == 2 ? src.width : src.height;
+        int turnedHeight = turns == 2 ? src.height : src.width;
+        turned.reset(new unsigned char[static_cast<size_t>(turnedWidth) * turnedHeight * channels]);
+        plane = {turned.get(), turnedWidth, turnedHeight, src.channels, turnedWidth * channels};
+        if (turns == 2) {
+            for (int y = 0; y < src.height; y++) {
+                std::memcpy(plane.data + y * plane.stride, src.data + y * src.stride, src.width * channels);
+            }
+            rotateHalfTurn(plane, pool);
+            originX = src.width / 2.0 - 1;
+            originY = src.height / 2.0 - 1;
+        } else {
+            rotateQuarterTurns(src, plane, turns, pool);
+            originX = turns == 1 ? src.height / 2.0 - 1 : src.height / 2.0;
+            originY = turns == 1 ? src.width / 2.0 : src.width / 2.0 - 1;
+        }
+    }
+
+    // rotateBilinear samples src at centre + R(-residual) (u - dst centre),
+    // and R(-residual) = X(alpha) Y(beta) X(alpha) with the shears
+    // X(a)(x, y) = (x + a y, y) and Y(b)(x, y) = (x, y + b x). Working back
+    // from the source: I2(r) = I1(X(alpha) r), I3(q) = I2(Y(beta) q) and
+    // dst(u) = I3(X(alpha) (u - dst centre)). Each is a row shear of the
+    // previous image, Y(beta) after transposing, so every pass reads whole
+    // source rows.
+    double radians = residual * PI / 180.0;
+    double alpha = std::tan(radians / 2);
+    double beta = -std::sin(radians);
+    double dstCenterX = dst.width / 2.0;
+    double dstCenterY = dst.height / 2.0;
+
+    // I2 keeps the rows of I1 (r.y = row - originY); its columns span the
+    // sheared source, with a margin for the interpolation, and start at
+    // plane x = firstX, aligned with the source pixels so a zero shear
+    // copies rows exactly
+    double topY = -originY;
+    double bottomY = plane.height - 1 - originY;
+    double leftX = -originX;
+    double rightX = plane.width - 1 - originX;
+    double minX = std::min(leftX - alpha * topY, leftX - alpha * bottomY);
+    double maxX = std::max(rightX - alpha * topY, rightX - alpha * bottomY);
+    double firstX = std::floor(minX + originX) - 1 - originX;
+    int planeWidth = static_cast<int>(std::ceil(maxX - firstX)) + 2;
+
+    // I2 is sheared from I1 and stored transposed (plane.height x
+    // planeWidth): row i is r.x = i + firstX, column j is r.y = j - originY
+    std::unique_ptr<unsigned char[]> shearedData(new unsigned char[static_cast<size_t>(planeWidth) * plane.height * channels]);
+    ImageView shearedT = {shearedData.get(), plane.height, planeWidth, src.channels, plane.height * channels};
+    shearTransposed(plane, shearedT, firstX + originX - alpha * originY, alpha, pool);
+
+    // I3 is sheared from the rows of transposed I2 and transposed back: row
+    // j is the destination row q.y = j - dstCenterY, column i is
+    // q.x = i + firstX, read from I2 at q.y + beta * q.x
+    std::unique_ptr<unsigned char[]> verticalData(new unsigned char[static_cast<size_t>(planeWidth) * dst.height * channels]);
+    ImageView vertical = {verticalData.get(), planeWidth, dst.height, src.channels, planeWidth * channels};
+    shearTransposed(shearedT, vertical, originY - dstCenterY + beta * firstX, beta, pool);
+    shearedData.reset();
+
+    shearRows(vertical, dst, -dstCenterX - firstX - alpha * dstCenterY, alpha, pool);
+}
+
+void scaleBilinear(const ImageView& src, const ImageView& dst, Interpolation interpolation, ThreadPool* pool) {
+    double xRatio = src.width / static_cast<double>(dst.width);
+    double yRatio = src.height / static_cast<double>(dst.height);
+
+    withChannels(src.channels, [&](auto c) {
+        if (interpolation == Interpolation::FixedPoint) {
+            scaleFixed<decltype(c)::value>(src, dst, xRatio, yRatio, pool);
+        } else {
+            scaleDouble<decltype(c)::value>(src, dst, xRatio, yRatio, pool);
+        }
+    });
+}
@@ -0,0 +1,77 @@
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include <cstddef>
+
+class ThreadPool;
+
+// Non-owning view of an interleaved 8-bit image
+struct ImageView {
+    unsigned char* data;
+    int width;
+    int height;
+    int channels;
+
+    // Bytes between the starts of consecutive rows
+    size_t stride;
+};
+
+// Arithmetic used to blend the 2x2 neighbourhood of a bilinear sample
+enum class Interpolation {
+    Double,    // Double-precision weights, result truncated (the original kernel)
+    FixedPoint // 15-bit integer weights and 16-bit intermediates, result
+               // rounded; within +-1 of Double
+};
+
+// 2x3 affine transform mapping (x, y) to
+// (m[0] * x + m[1] * y + m[2], m[3] * x + m[4] * y + m[5])
+struct AffineMatrix {
+    double m[6];
+};
+
+// The resampling functions below split the destination into bands of rows
+// and spread them over pool's threads when one is given; every pixel is
+// computed the same way, so the output does not depend on the thread count.
+
+// Inverse of an invertible transform
+AffineMatrix invertAffine(const AffineMatrix& matrix);
+
+// Resample src into dst through matrix, which maps source pixel coordinates
+// to destination ones. Pixels of dst that map outside src are set to zero.
+void warpBilinear(const ImageView& src, const ImageView& dst, const AffineMatrix& matrix,
+                  Interpolation interpolation = Interpolation::FixedPoint, ThreadPool* pool = nullptr);
+
+// Rotate src by angle degrees about its centre into dst, which is centred on
+// the same point. Pixels of dst that map outside src are set to zero.
+void rotateBilinear(const ImageView& src, const ImageView& dst, double angle,
+                    Interpolation interpolation = Interpolation::FixedPoint, ThreadPool* pool = nullptr);
+
+// Same rotation and geometry as rotateBilinear, computed as exact quarter
+// turns followed by three shears (Paeth): a row shear, a column shear done as
+// a row shear between two transposes, and a row shear. Every pass shifts
+// whole rows by a sub-pixel amount with linear interpolation, so memory is
+// read sequentially; edges blend into the zero background. Always uses
+// fixed-point weights.
+void rotateShear(const ImageView& src, const ImageView& dst, double angle, ThreadPool* pool = nullptr);
+
+// Exact rotation by quarterTurns (1 or 3) quarter turns, in the same
+// direction as rotateBilinear with 90 or 270 degrees; dst has src's width
+// and height swapped. Pixels are copied, not resampled.
+void rotateQuarterTurns(const ImageView& src, const ImageView& dst, int quarterTurns, ThreadPool* pool = nullptr);
+
+// Exact 180-degree rotation in place
+void rotateHalfTurn(const ImageView& image, ThreadPool* pool = nullptr);
+
+// Allow the fixed-point kernels to use AVX2 when the CPU supports it (the
+// default); disabling forces the portable scalar code
+void setSimdEnabled(bool enabled);
+
+// Walk warps in destination tiles sized for the L2 cache (the default);
+// disabling walks whole rows in order. Output is the same either way.
+void setTilingEnabled(bool enabled);
+
+// Resize src to fill dst
+void scaleBilinear(const ImageView& src, const ImageView& dst,
+                   Interpolation interpolation = Interpolation::FixedPoint, ThreadPool* pool = nullptr);
+
+#endif // RESAMPLE_H
@@ -0,0 +1,458 @@
+#include "server.h"
+#include <iostream>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "image_processor.h"
+#include "thread_pool.h"
+
+namespace {
+
+// Longest protocol line accepted and largest image carried by one message
+const size_t maxLineBytes = 4096;
+const size_t maxPayloadBytes = size_t(512) * 1024 * 1024;
+
+// How often the accept loop checks the stop flag
+const int acceptPollMs = 100;
+
+bool socketAddress(const std::string& path, sockaddr_un& address) {
+    std::memset(&address, 0, sizeof(address));
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Invalid socket path: " << path << std::endl;
+        return false;
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+// Remove the socket file a previous run left at path, which is one nothing
+// is listening on any more. Returns true if path is free for bind; refuses
+// to touch any other file or a live server's socket.
+bool removeStaleSocket(const std::string& path, const sockaddr_un& address) {
+    struct stat info;
+    if (lstat(path.c_str(), &info) != 0) {
+        if (errno == ENOENT) {
+            return true;
+        }
+        std::cerr << "Failed to check " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    if (!S_ISSOCK(info.st_mode)) {
+        std::cerr << path << " exists and is not a socket" << std::endl;
+        return false;
+    }
+
+    // A socket a server still accepts on (or has a full backlog on) is live
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (probe < 0) {
+        std::cerr << "Failed to create socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    bool live = ::connect(probe, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0 ||
+                errno == EAGAIN || errno == EINPROGRESS;
+    close(probe);
+    if (live) {
+        std::cerr << "Another server is listening on " << path << std::endl;
+        return false;
+    }
+
+    if (unlink(path.c_str()) != 0 && errno != ENOENT) {
+        std::cerr << "Failed to remove " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool writeAll(int fd, const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t sent = send(fd, bytes, size, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        bytes += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+// Receive until pending holds a whole line, then move it (without the
+// newline) into line
+bool readLine(int fd, std::string& pending, std::string& line) {
+    size_t scanned = 0;
+    for (;;) {
+        size_t end = pending.find('\n', scanned);
+        if (end != std::string::npos) {
+            line.assign(pending, 0, end);
+            pending.erase(0, end + 1);
+            return true;
+        }
+        if (pending.size() > maxLineBytes) {
+            return false;
+        }
+        scanned = pending.size();
+
+        char buffer[4096];
+        ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) {
+            return false;
+        }
+        pending.append(buffer, received);
+    }
+}
+
+// Fill bytes with the next size bytes of the stream, pending ones first
+bool readBytes(int fd, std::string& pending, std::vector<unsigned char>& bytes, size_t size) {
+    bytes.resize(size);
+    size_t have = std::min(size, pending.size());
+    if (have > 0) {
+        std::memcpy(bytes.data(), pending.data(), have);
+        pending.erase(0, have);
+    }
+    while (have < size) {
+        ssize_t received = recv(fd, bytes.data() + have, size - have, 0);
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) {
+            return false;
+        }
+        have += received;
+    }
+    return true;
+}
+
+bool hasWhitespace(const std::string& text) {
+    return std::any_of(text.begin(), text.end(), [](unsigned char c) { return std::isspace(c); });
+}
+
+// Accepted connections waiting for a worker, and those being served so
+// that close() can cut them off
+class ConnectionQueue {
+public:
+    void push(int fd) {
+        std::lock_guard<std::mutex> guard(mutex);
+        waiting.push_back(fd);
+        ready.notify_one();
+    }
+
+    // Next connection to serve, or -1 once the queue is closed. onIdle (if
+    // set) runs without the lock each time idlePeriod passes with nothing
+    // to serve
+    int pop(std::chrono::milliseconds idlePeriod, const std::function<void()>& onIdle) {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!ready.wait_for(lock, idlePeriod, [&] { return closing || !waiting.empty(); })) {
+            if (onIdle) {
+                lock.unlock();
+                onIdle();
+                lock.lock();
+            }
+        }
+        if (closing) {
+            return -1;
+        }
+        int fd = waiting.front();
+        waiting.pop_front();
+        active.insert(fd);
+        return fd;
+    }
+
+    // Close a connection returned by pop
+    void finish(int fd) {
+        std::lock_guard<std::mutex> guard(mutex);
+        active.erase(fd);
+        ::close(fd);
+    }
+
+    // Drop waiting connections, shut down the ones being served (their
+    // workers see the peer hang up) and release every pop
+    void close() {
+        std::lock_guard<std::mutex> guard(mutex);
+        closing = true;
+        for (int fd : waiting) {
+            ::close(fd);
+        }
+        waiting.clear();
+        for (int fd : active) {
+            shutdown(fd, SHUT_RDWR);
+        }
+        ready.notify_all();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<int> waiting;
+    std::set<int> active;
+    bool closing = false;
+};
+
+// Run one request on processor. On success output holds the encoded result
+// when it goes back to the client, and is empty when it went to a file.
+// Returns an error message, or an empty string on success.
+std::string runJob(ImageProcessor& processor, bool twoPass, const ServerRequest& request,
+                   const std::vector<unsigned char>& input, std::vector<unsigned char>& output) {
+    output.clear();
+    std::string format = request.format;
+    if (format == "-") {
+        size_t dotPos = request.output.find_last_of('.');
+        if (request.output == "-" || dotPos == std::string::npos) {
+            return "format required";
+        }
+        format = request.output.substr(dotPos + 1);
+    }
+
+    // Reject what cannot succeed before paying for the decode
+    if (!ImageProcessor::isSupportedFormat(format)) {
+        return "unsupported format " + format;
+    }
+    if (!std::isfinite(request.angle) || !std::isfinite(request.scale) || request.scale <= 0) {
+        return "invalid angle or scale";
+    }
+    if (request.input != "-" && !input.empty()) {
+        return "unexpected bytes with an input path";
+    }
+
+    bool loaded = request.input == "-" ? processor.loadImageFromMemory(input.data(), input.size())
+                                       : processor.loadImage(request.input);
+    if (!loaded) {
+        return "cannot load input";
+    }
+
+    if (!transformJob(processor, request.angle, request.scale, twoPass)) {
+        return "transform failed";
+    }
+    if (request.output != "-") {
+        return processor.saveImage(request.output, format) ? "" : "cannot write " + request.output;
+    }
+    if (!processor.encodeImage(format, output)) {
+        return "cannot encode as " + format;
+    }
+    return "";
+}
+
+// Answer requests on fd until the client hangs up or breaks the protocol.
+// input and output are the worker's buffers, kept between requests.
+void serveConnection(int fd, ImageProcessor& processor, bool twoPass,
+                     std::vector<unsigned char>& input, std::vector<unsigned char>& output) {
+    std::string pending, line;
+    while (readLine(fd, pending, line)) {
+        std::istringstream fields(line);
+        std::string command, extra;
+        ServerRequest request;
+        size_t length;
+        if (!(fields >> command >> request.angle >> request.scale >> request.input >> request.output
+                    >> request.format >> length) ||
+            command != "PROCESS" || (fields >> extra) || length > maxPayloadBytes) {
+            // The length of what follows is unknown, so the stream cannot resync
+            std::string reply = "ERROR malformed request\n";
+            writeAll(fd, reply.data(), reply.size());
+            return;
+        }
+        if (!readBytes(fd, pending, input, length)) {
+            return;
+        }
+
+        // A failed job is answered, never allowed to take the server down
+        auto start = std::chrono::high_resolution_clock::now();
+        std::string error;
+        try {
+            error = runJob(processor, twoPass, request, input, output);
+        } catch (const std::exception& exception) {
+            error = std::string("internal error: ") + exception.what();
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+
+        std::ostringstream header;
+        if (!error.empty()) {
+            header << "ERROR " << error << "\n";
+            output.clear();
+        } else {
+            int width, height, channels;
+            processor.getImageInfo(width, height, channels);
+            header << "OK " << width << " " << height << " "
+                   << std::chrono::duration<double, std::milli>(end - start).count() << " " << output.size() << "\n";
+        }
+
+        // Only the header needed the image; an idle worker holds no pixels
+        processor.clear();
+        std::string reply = header.str();
+        if (!writeAll(fd, reply.data(), reply.size()) || !writeAll(fd, output.data(), output.size())) {
+            return;
+        }
+    }
+}
+
+} // namespace
+
+bool runServer(const std::string& socketPath, const BatchSettings& settings, const std::atomic<bool>& stop) {
+    sockaddr_un address;
+    if (!socketAddress(socketPath, address)) {
+        return false;
+    }
+
+    int listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) {
+        std::cerr << "Failed to create socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    if (!removeStaleSocket(socketPath, address)) {
+        close(listenFd);
+        return false;
+    }
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+        listen(listenFd, SOMAXCONN) < 0) {
+        std::cerr << "Failed to listen on " << socketPath << ": " << std::strerror(errno) << std::endl;
+        close(listenFd);
+        return false;
+    }
+
+    ConnectionQueue connections;
+    std::thread acceptor([&] {
+        pollfd listener = {listenFd, POLLIN, 0};
+        while (!stop.load()) {
+            if (poll(&listener, 1, acceptPollMs) <= 0) continue;
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd >= 0) {
+                connections.push(fd);
+            }
+        }
+        connections.close();
+    });
+
+    // Each worker's allocator, processor and threads live as long as the
+    // server, so requests find the arena grown and the threads started
+    int workers = std::max(1, settings.workers);
+    ThreadPool pool(workers);
+    pool.parallelFor(workers, [&](int) {
+        std::unique_ptr<BuddyAllocator> allocator = makeWorkerAllocator(settings, false);
+        ThreadPool transformPool(settings.transformThreads);
+        ImageProcessor processor(settings.useBuddySystem, allocator.get());
+        processor.setThreadPool(&transformPool);
+        if (settings.shear) {
+            processor.setRotationMode(ImageProcessor::RotationMode::Shear);
+        }
+
+        // Without traffic nothing else would notice the arenas emptied by
+        // the last request going past their idle period
+        std::chrono::milliseconds idlePeriod(std::max<long>(settings.poolIdleMs, acceptPollMs));
+        std::function<void()> releaseIdle;
+        if (allocator) {
+            releaseIdle = [&] { allocator->releaseIdleArenas(); };
+        }
+
+        std::vector<unsigned char> input, output;
+        int fd;
+        while ((fd = connections.pop(idlePeriod, releaseIdle)) >= 0) {
+            try {
+                serveConnection(fd, processor, settings.twoPass, input, output);
+            } catch (const std::exception& exception) {
+                // Protocol buffers (a request's bytes) could not be allocated
+                std::cerr << "Dropping connection: " << exception.what() << std::endl;
+            }
+            connections.finish(fd);
+        }
+    });
+
+    // Leave the path alone if another file or server has taken it over
+    acceptor.join();
+    close(listenFd);
+    removeStaleSocket(socketPath, address);
+    return true;
+}
+
+ServerClient::ServerClient() : socketFd(-1) {
+}
+
+ServerClient::~ServerClient() {
+    if (socketFd >= 0) {
+        close(socketFd);
+    }
+}
+
+bool ServerClient::connect(const std::string& socketPath) {
+    sockaddr_un address;
+    if (!socketAddress(socketPath, address)) {
+        return false;
+    }
+    if (socketFd >= 0) {
+        close(socketFd);
+    }
+    pending.clear();
+
+    socketFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (socketFd < 0 || ::connect(socketFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        std::cerr << "Failed to connect to " << socketPath << ": " << std::strerror(errno) << std::endl;
+        if (socketFd >= 0) {
+            close(socketFd);
+            socketFd = -1;
+        }
+        return false;
+    }
+    return true;
+}
+
+bool ServerClient::process(const ServerRequest& request, const std::vector<unsigned char>& inputBytes,
+                           ServerReply& reply) {
+    reply.ok = false;
+    reply.error.clear();
+    reply.bytes.clear();
+    if (socketFd < 0) {
+        return false;
+    }
+    if (hasWhitespace(request.input) || hasWhitespace(request.output) || hasWhitespace(request.format)) {
+        std::cerr << "Paths and formats sent to the server cannot contain whitespace" << std::endl;
+        return false;
+    }
+
+    size_t length = request.input == "-" ? inputBytes.size() : 0;
+    std::ostringstream header;
+    header << std::setprecision(17) << "PROCESS " << request.angle << " " << request.scale << " "
+           << request.input << " " << request.output << " " << (request.format.empty() ? "-" : request.format)
+           << " " << length << "\n";
+    std::string line = header.str();
+    if (!writeAll(socketFd, line.data(), line.size()) || !writeAll(socketFd, inputBytes.data(), length)) {
+        return false;
+    }
+
+    if (!readLine(socketFd, pending, line)) {
+        return false;
+    }
+    std::istringstream fields(line);
+    std::string status;
+    fields >> status;
+    if (status == "ERROR") {
+        std::getline(fields >> std::ws, reply.error);
+        return true;
+    }
+
+    size_t replyLength;
+    if (status != "OK" || !(fields >> reply.width >> reply.height >> reply.milliseconds >> replyLength) ||
+        replyLength > maxPayloadBytes) {
+        return false;
+    }
+    if (!readBytes(socketFd, pending, reply.bytes, replyLength)) {
+        return false;
+    }
+    reply.ok = true;
+    return true;
+}
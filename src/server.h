@@ -0,0 +1,77 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include "batch.h"
+
+// Wire protocol of the job server, over a Unix stream socket. A connection
+// carries any number of requests, each answered before the next is read.
+//
+//   request:  PROCESS <angle> <scale> <input> <output> <format> <length>\n
+//             followed by <length> bytes
+//   response: OK <width> <height> <milliseconds> <length>\n
+//             followed by <length> bytes
+//             or ERROR <message>\n
+//
+// input is a path the server reads, or '-' for the encoded image sent as the
+// request's bytes (length is 0 otherwise). output is a path the server
+// writes, or '-' to get the encoded result back as the response's bytes.
+// format is jpg, jpeg, png or bmp, or '-' to take it from output's
+// extension. Paths cannot contain whitespace. width and height are those of
+// the result and milliseconds the time the server spent on the job.
+
+// Serve jobs on a Unix socket at socketPath until stop becomes true. A
+// socket file a previous run left there is replaced; any other file, or a
+// socket another server is listening on, makes it fail. settings.workers
+// threads each keep one ImageProcessor, Buddy arena and pool of
+// settings.transformThreads threads warm across requests (the image itself
+// is freed after each reply), and serve one connection at a time; further
+// connections wait for a free worker. Returns false if the socket cannot be
+// set up.
+bool runServer(const std::string& socketPath, const BatchSettings& settings, const std::atomic<bool>& stop);
+
+// One job sent to a server
+struct ServerRequest {
+    double angle;
+    double scale;
+    std::string input;
+    std::string output;
+    std::string format;
+};
+
+// The server's answer; bytes holds the encoded image when output was '-'
+struct ServerReply {
+    bool ok;
+    std::string error;
+    int width;
+    int height;
+    double milliseconds;
+    std::vector<unsigned char> bytes;
+};
+
+// Client side of the protocol over one persistent connection
+class ServerClient {
+public:
+    ServerClient();
+    ~ServerClient();
+
+    ServerClient(const ServerClient&) = delete;
+    ServerClient& operator=(const ServerClient&) = delete;
+
+    bool connect(const std::string& socketPath);
+
+    // Send request, with inputBytes as the image when request.input is '-',
+    // and wait for the reply. Returns false if the connection fails; a job
+    // the server rejects returns true with reply.ok false.
+    bool process(const ServerRequest& request, const std::vector<unsigned char>& inputBytes, ServerReply& reply);
+
+private:
+    int socketFd;
+
+    // Bytes received past the end of the last reply
+    std::string pending;
+};
+
+#endif // SERVER_H
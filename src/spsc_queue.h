@@ -0,0 +1,71 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Bounded lock-free queue between exactly one producer thread and one
+// consumer thread: a ring of capacity slots (rounded up to a power of two)
+// indexed by two counters that only their owning side writes.
+template <class T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity) : head(0), tail(0) {
+        size_t size = 1;
+        while (size < capacity) size *= 2;
+        slots.resize(size);
+        mask = size - 1;
+    }
+
+    // Producer side; false when the queue is full
+    bool tryPush(const T& value) {
+        size_t position = tail.load(std::memory_order_relaxed);
+        if (position - head.load(std::memory_order_acquire) == slots.size()) return false;
+        slots[position & mask] = value;
+        tail.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side; false when the queue is empty
+    bool tryPop(T& value) {
+        size_t position = head.load(std::memory_order_relaxed);
+        if (position == tail.load(std::memory_order_acquire)) return false;
+        value = slots[position & mask];
+        head.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Blocking variants: spin briefly, then yield, then sleep in short steps
+    void push(const T& value) {
+        for (int attempt = 0; !tryPush(value); attempt++) backOff(attempt);
+    }
+
+    T pop() {
+        T value;
+        for (int attempt = 0; !tryPop(value); attempt++) backOff(attempt);
+        return value;
+    }
+
+private:
+    static void backOff(int attempt) {
+        if (attempt < 64) return;
+        if (attempt < 128) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+
+    std::vector<T> slots;
+    size_t mask;
+
+    // Next slot to pop (written by the consumer) and to push (written by
+    // the producer), on separate cache lines
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+};
+
+#endif // SPSC_QUEUE_H
@@ -0,0 +1,90 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(int threads)
+    : task(nullptr), count(0), nextIndex(0), busyWorkers(0), generation(0), stopping(false) {
+    for (int i = 1; i < threads; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(stateMutex);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+int ThreadPool::size() const {
+    return static_cast<int>(workers.size()) + 1;
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int)>& task) {
+    if (count <= 0) return;
+    if (workers.empty() || count == 1) {
+        for (int i = 0; i < count; i++) {
+            task(i);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> job(jobMutex);
+    {
+        std::lock_guard<std::mutex> guard(stateMutex);
+        this->task = &task;
+        this->count = count;
+        nextIndex.store(0, std::memory_order_relaxed);
+        busyWorkers = static_cast<int>(workers.size());
+        failure = nullptr;
+        generation++;
+    }
+    jobReady.notify_all();
+
+    runIndices();
+
+    // Every worker checks in, even one that woke too late to find work, so
+    // none still holds a pointer to task once this returns
+    std::unique_lock<std::mutex> lock(stateMutex);
+    jobDone.wait(lock, [this] { return busyWorkers == 0; });
+    this->task = nullptr;
+    if (failure) {
+        std::rethrow_exception(failure);
+    }
+}
+
+void ThreadPool::runIndices() {
+    for (int i = nextIndex.fetch_add(1); i < count; i = nextIndex.fetch_add(1)) {
+        try {
+            (*task)(i);
+        } catch (...) {
+            // Hand out no more indices and keep the first exception for the caller
+            nextIndex.store(count);
+            std::lock_guard<std::mutex> guard(stateMutex);
+            if (!failure) {
+                failure = std::current_exception();
+            }
+        }
+    }
+}
+
+void ThreadPool::workerLoop() {
+    unsigned long seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(stateMutex);
+            jobReady.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+        }
+
+        runIndices();
+
+        std::lock_guard<std::mutex> guard(stateMutex);
+        if (--busyWorkers == 0) {
+            jobDone.notify_one();
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that run index ranges in parallel. The thread
+// calling parallelFor works alongside the workers, so a pool of N threads
+// starts N - 1 of them; a pool of one runs everything inline.
+class ThreadPool {
+public:
+    explicit ThreadPool(int threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Threads taking part in a parallelFor, the caller included
+    int size() const;
+
+    // Call task(i) for every i in [0, count) and return once all calls have
+    // finished. Indices are handed out one at a time to whichever thread is
+    // free. Concurrent callers are served one after another. If a call
+    // throws, no further indices are started and the first exception is
+    // rethrown here once the running calls have finished.
+    void parallelFor(int count, const std::function<void(int)>& task);
+
+private:
+    void workerLoop();
+
+    // Claim and run indices of the current job until none are left
+    void runIndices();
+
+    std::vector<std::thread> workers;
+
+    // Serializes parallelFor callers
+    std::mutex jobMutex;
+
+    // Guards the job fields below and the two condition variables
+    std::mutex stateMutex;
+    std::condition_variable jobReady;
+    std::condition_variable jobDone;
+
+    // Current job; generation changes each time one is posted
+    const std::function<void(int)>* task;
+    int count;
+    std::atomic<int> nextIndex;
+    int busyWorkers;
+
+    // First exception thrown by the current job's task
+    std::exception_ptr failure;
+    unsigned long generation;
+    bool stopping;
+};
+
+#endif // THREAD_POOL_H